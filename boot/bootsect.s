@@ -42,6 +42,10 @@ ENDSEG   = SYSSEG + SYSSIZE		! where to stop loading
 !		0x301 - first partition on first drive etc
 ROOT_DEV = 0x306
 
+! BLK_SCHED:	0xffff - the BLK_DEADLINE mask from linux/config.h.
+!		else the mask of block majors to use the deadline scheduler
+BLK_SCHED = 0xffff
+
 entry _start
 _start:
 	mov	ax,#BOOTSEG
@@ -246,7 +250,9 @@ msg1:
 	.ascii "Loading system ..."
 	.byte 13,10,13,10
 
-.org 508
+.org 506
+blk_sched:
+	.word BLK_SCHED
 root_dev:
 	.word ROOT_DEV
 boot_flag:
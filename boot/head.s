@@ -128,11 +128,12 @@ pg3:
 .org 0x5000
 /*
  * tmp_floppy_area is used by the floppy-driver when DMA cannot
- * reach to a buffer-block. It needs to be aligned, so that it isn't
- * on a 64kB border.
+ * reach to a buffer-block, and for transfers of several buffers at
+ * once. It holds a full cylinder (2*18 sectors), and needs to be
+ * aligned, so that it isn't on a 64kB border.
  */
 tmp_floppy_area:
-	.fill 1024,1,0
+	.fill 18432,1,0
 
 after_page_tables:
 	pushl $0		# These are the parameters to main :-)
@@ -64,9 +64,186 @@ __asm__ __volatile__ ("cld\n" \         // 清方向位
 	:"=c" (__res):"c" (0),"S" (addr)); \
 __res;})
 
+#define ffz(word) ({ \
+int __res; \
+__asm__("bsfl %1,%0":"=r" (__res):"r" (~(word))); \
+__res;})
+
+/*
+ * find_next_zero() is find_first_zero() starting at bit 'nr'. It
+ * returns 8192 if there's no zero bit from there on.
+ */
+static int find_next_zero(char * addr, int nr)
+{
+	unsigned long * p = ((unsigned long *) addr) + (nr >> 5);
+
+	if (nr & 31) {
+		if (~(*p | ((1UL << (nr & 31)) - 1)))
+			return (nr & ~31) + ffz(*p | ((1UL << (nr & 31)) - 1));
+		nr = (nr & ~31) + 32;
+		p++;
+	}
+	for ( ; nr < 8192 ; nr += 32, p++)
+		if (~*p)
+			return nr + ffz(*p);
+	return 8192;
+}
+
 //// 释放设备dev上数据区中的逻辑块block.
 // 复位指定逻辑块block对应的逻辑块位图bit位
 // 参数：dev是设备号，block是逻辑块号（盘块号）
+/*
+ * Each super block keeps the number of free bits in each of its map
+ * blocks, so that allocation can go straight to a block that has some,
+ * and ustat() needn't count. Allocation starts at the map block used
+ * last time (s_zlast/s_ilast) and goes round from there.
+ *
+ * The map blocks aren't kept in memory: they are read through the
+ * buffer cache when they are needed, and can be thrown out again when
+ * they are clean. A map block is counted the first time it is read, so
+ * mounting doesn't have to read them all; until then s_free_zones and
+ * s_free_inodes only cover the ones counted (s_zcounted/s_icounted).
+ */
+static char nibblemap[] = { 4,3,3,2,3,2,2,1,3,2,2,1,2,1,1,0 };
+
+static int count_free(struct buffer_head * bh, int bits)
+{
+	unsigned char c;
+	int i, n = 0;
+
+	for (i=0 ; i < bits/8 ; i++) {
+		c = bh->b_data[i];
+		n += nibblemap[c & 15] + nibblemap[c >> 4];
+	}
+	for (i = bits & ~7 ; i < bits ; i++)
+		if (!(bh->b_data[i>>3] & (1 << (i&7))))
+			n++;
+	return n;
+}
+
+#define MAP_BITS(sb,zmap) ((zmap) ? \
+	(sb)->s_nzones - (sb)->s_firstdatazone + 1 : (sb)->s_ninodes + 1)
+#define MAP_BLOCK(sb,zmap,nr) (2 + ((zmap) ? (sb)->s_imap_blocks : 0) + (nr))
+
+/*
+ * read_map() reads block 'nr' of the zone map (or of the inode map),
+ * and counts it if it hasn't been. Bit 0 of either map is never free.
+ */
+static struct buffer_head * read_map(struct super_block * sb, int zmap,
+	int nr)
+{
+	struct buffer_head * bh;
+	unsigned char * counted = zmap ? &sb->s_zcounted : &sb->s_icounted;
+	int bits;
+
+	if (!(bh = bread(sb->s_dev,MAP_BLOCK(sb,zmap,nr))))
+		return NULL;
+	if (!nr)
+		bh->b_data[0] |= 1;
+	if (*counted & (1 << nr))
+		return bh;
+	*counted |= 1 << nr;
+	bits = MAP_BITS(sb,zmap) - nr*8192;
+	if (bits > 8192)
+		bits = 8192;
+	if (zmap)
+		sb->s_free_zones += (sb->s_zfree[nr] = count_free(bh,bits));
+	else
+		sb->s_free_inodes += (sb->s_ifree[nr] = count_free(bh,bits));
+	return bh;
+}
+
+/*
+ * init_free_counts() is called by read_super(): nothing is counted yet.
+ */
+void init_free_counts(struct super_block * sb)
+{
+	int i;
+
+	for (i=0 ; i<Z_MAP_SLOTS ; i++)
+		sb->s_zfree[i] = 0;
+	for (i=0 ; i<I_MAP_SLOTS ; i++)
+		sb->s_ifree[i] = 0;
+	sb->s_free_zones = sb->s_free_inodes = 0;
+	sb->s_zcounted = sb->s_icounted = 0;
+	sb->s_reserved = 0;
+	sb->s_zlast = sb->s_ilast = 0;
+}
+
+/*
+ * count_map() counts map blocks that haven't been until 'want' free
+ * bits are known of, or all of them are counted. It returns the number
+ * of free zones (or inodes) known of.
+ */
+unsigned long count_map(struct super_block * sb, int zmap, unsigned long want)
+{
+	int i, ahead = 0, nr = zmap ? sb->s_zmap_blocks : sb->s_imap_blocks;
+	unsigned char * counted = zmap ? &sb->s_zcounted : &sb->s_icounted;
+	unsigned long * nfree = zmap ? &sb->s_free_zones : &sb->s_free_inodes;
+
+	for (i=0 ; i<nr && *nfree<want ; i++)
+		if (!(*counted & (1 << i))) {
+/* the map blocks are contiguous: read the rest of them with this one */
+			if (!ahead && i+1<nr) {
+				brelse(bread_cluster(sb->s_dev,MAP_BLOCK(sb,zmap,i),nr-i));
+				ahead = 1;
+			}
+			brelse(read_map(sb,zmap,i));
+		}
+	return *nfree;
+}
+
+/*
+ * alloc_bit() takes a free bit out of the zone map (or inode map). With
+ * a goal, it takes the first free bit at or after it, going on to the
+ * following map blocks and round. Without one (goal < 0) it takes the
+ * first free bit of the first map block that has one, starting at the
+ * one used last. It returns the bit number in the whole map, or -1 if
+ * there is none.
+ */
+static int alloc_bit(struct super_block * sb, int zmap, int goal)
+{
+	struct buffer_head * bh;
+	unsigned short * nfree = zmap ? sb->s_zfree : sb->s_ifree;
+	unsigned char * last = zmap ? &sb->s_zlast : &sb->s_ilast;
+	unsigned char counted = zmap ? sb->s_zcounted : sb->s_icounted;
+	int nr = zmap ? sb->s_zmap_blocks : sb->s_imap_blocks;
+	int limit = MAP_BITS(sb,zmap);
+	int i,j,k,from,start;
+
+	if (!nr)
+		return -1;
+	if (goal >= limit)
+		goal = -1;
+	start = (goal < 0) ? *last : goal >> 13;
+	for (i=0 ; i<=nr ; i++) {
+		k = (start + i) % nr;
+		if ((counted & (1 << k)) && !nfree[k])
+			continue;
+		if (!(bh = read_map(sb,zmap,k)))
+			continue;
+		from = (i == 0 && goal >= 0) ? goal & 8191 : 0;
+		j = from ? find_next_zero(bh->b_data,from) :
+			find_first_zero(bh->b_data);
+		if (j >= 8192 || j + k*8192 >= limit) {
+			if (!from && nfree[k]) {
+				printk("alloc_bit: free count was wrong\n\r");
+				nfree[k] = 0;
+			}
+			brelse(bh);
+			continue;
+		}
+		if (set_bit(j,bh->b_data))
+			panic("alloc_bit: bit already set");
+		mark_buffer_dirty(bh);
+		brelse(bh);
+		nfree[k]--;
+		*last = k;
+		return j + k*8192;
+	}
+	return -1;
+}
+
 void free_block(int dev, int block)
 {
 	struct super_block * sb;
@@ -91,7 +268,7 @@ void free_block(int dev, int block)
 				dev,block,bh->b_count);
 			return;
 		}
-		bh->b_dirt=0;
+		clear_buffer_dirty(bh);
 		bh->b_uptodate=0;
 		brelse(bh);
 	}
@@ -101,12 +278,21 @@ void free_block(int dev, int block)
     // 即可计算出指定块block在逻辑位图中的哪个块上。而block&8192可以得到block在逻辑块位图
     // 当前块中的bit偏移位置。
 	block -= sb->s_firstdatazone - 1 ;
-	if (clear_bit(block&8191,sb->s_zmap[block/8192]->b_data)) {
+/* if the map can't be read, the block stays taken: better than a panic */
+	if (!(bh = read_map(sb,1,block/8192))) {
+		printk("free_block: can't read zone map, block (%04x:%d) lost\n\r",
+			dev,block+sb->s_firstdatazone-1);
+		return;
+	}
+	if (clear_bit(block&8191,bh->b_data)) {
 		printk("block (%04x:%d) ",dev,block+sb->s_firstdatazone-1);
 		panic("free_block: bit already cleared");
 	}
     // 最后置相应逻辑块位图所在缓冲区已修改标志。
-	sb->s_zmap[block/8192]->b_dirt = 1;
+	mark_buffer_dirty(bh);
+	brelse(bh);
+	sb->s_zfree[block/8192]++;
+	sb->s_free_zones++;
 }
 
 //// 向设备申请一个逻辑块。
@@ -114,49 +300,93 @@ void free_block(int dev, int block)
 // 空闲逻辑块)。然后位置对应逻辑块在逻辑块位图中的bit位。接着为该逻辑块在缓冲区中取得
 // 一块对应缓冲块。最后将该缓冲块清零，并设置其已更新标志和已修改标志。并返回逻辑块
 // 号。函数执行成功则返回逻辑块号，否则返回0.
-int new_block(int dev)
+// 参数goal是希望得到的逻辑块号，将从它开始向后寻找空闲块；0表示没有要求。
+int new_block(int dev, int goal)
 {
-	struct buffer_head * bh;
 	struct super_block * sb;
-	int i,j;
+	int j;
 
-    // 首先获取设备dev的超级块。如果指定设备的超级块不存在，则出错当机。然后扫描
-    // 文件系统的8块逻辑位图，寻找首个0值bit位，以寻找空闲逻辑块，获取放置该逻辑块的
-    // 块号。如果全部扫描完8块逻辑块位图的所有bit位(i >= 8 或 j >= 8192)还没找到0值
-    // bit位或者位图所在的缓冲块指针无效(bh=NULL)则返回0退出(没有空闲逻辑块)。
+    // 首先获取设备dev的超级块。如果指定设备的超级块不存在，则出错当机。然后在还有
+    // 空闲位的逻辑块位图中取一个空闲bit位并置位。如果没有则返回0退出(没有空闲逻辑块)。
 	if (!(sb = get_super(dev)))
 		panic("trying to get new block from nonexistant device");
-	j = 8192;
-	for (i=0 ; i<8 ; i++)
-		if ((bh=sb->s_zmap[i]))
-			if ((j=find_first_zero(bh->b_data))<8192)
-				break;
-	if (i>=8 || !bh || j>=8192)
+/* the zones reserved for delayed blocks aren't ours to take */
+	if (sb->s_reserved && count_map(sb,1,sb->s_reserved+1) <= sb->s_reserved)
 		return 0;
-    // 接着设置找到的新逻辑块j对应逻辑块位图中的bit位。若对应bit位已经置位，则出错
-    // 停机。否则置存放位图的对应缓冲区块已修改标志。因为逻辑块位图仅表示盘上数据区
-    // 中逻辑块的占用情况，则逻辑块位图中bit位偏移值表示从数据区开始处算起的块号，
-    // 因此这里需要加上数据区第1个逻辑块的块号，把j转换成逻辑块号。此时如果新逻辑块
-    // 大于该设备上的总逻辑块数，则说明指定逻辑块在对应设备上不存在。申请失败，返回0退出。
-	if (set_bit(j,bh->b_data))
-		panic("new_block: bit already set");
-	bh->b_dirt = 1;
-	j += i*8192 + sb->s_firstdatazone-1;
+	if (goal >= sb->s_firstdatazone && goal < sb->s_nzones)
+		goal -= sb->s_firstdatazone-1;
+	else
+		goal = -1;
+	if ((j = alloc_bit(sb,1,goal)) < 0)
+		return 0;
+	sb->s_free_zones--;
+    // 因为逻辑块位图仅表示盘上数据区中逻辑块的占用情况，则逻辑块位图中bit位偏移值表示
+    // 从数据区开始处算起的块号，因此这里需要加上数据区第1个逻辑块的块号，把j转换成逻辑
+    // 块号。此时如果新逻辑块大于该设备上的总逻辑块数，则说明指定逻辑块在对应设备上不存在。
+    // 申请失败，返回0退出。
+	j += sb->s_firstdatazone-1;
 	if (j >= sb->s_nzones)
 		return 0;
-    // 然后在高速缓冲区中为该设备上指定的逻辑块号取得一个缓冲块，并返回缓冲块头指针。
-    // 因为刚取得的逻辑块其引用次数一定为1(getblk()中会设置)，因此若不为1则停机。
-    // 最后将新逻辑块清零，并设置其已更新标志和已修改标志。然后释放对应缓冲块，返回
-    // 逻辑块号。
-	if (!(bh=getblk(dev,j)))
+	zero_block(dev,j);
+	return j;
+}
+
+//// 清零一个新申请的逻辑块。
+// 在高速缓冲区中为该设备上指定的逻辑块号取得一个缓冲块。因为刚取得的逻辑块其引用
+// 次数一定为1(getblk()中会设置)，因此若不为1则停机。最后将新逻辑块清零，并设置其
+// 已更新标志和已修改标志。然后释放对应缓冲块。
+void zero_block(int dev, int block)
+{
+	struct buffer_head * bh;
+
+	if (!(bh=getblk(dev,block)))
 		panic("new_block: cannot get block");
 	if (bh->b_count != 1)
 		panic("new block: count is != 1");
 	clear_block(bh->b_data);
 	bh->b_uptodate = 1;
-	bh->b_dirt = 1;
+	mark_buffer_dirty(bh);
 	brelse(bh);
-	return j;
+}
+
+/*
+ * prealloc_blocks() claims up to 'count' zones right after 'block',
+ * stopping at the first one that's taken or at the end of the map
+ * block, so that there's only the one map buffer to dirty. The zones
+ * aren't cleared: that is done when they are used. It returns the
+ * number of zones claimed.
+ */
+int prealloc_blocks(int dev, int block, int count)
+{
+	struct super_block * sb;
+	struct buffer_head * bh;
+	int bit,n;
+
+	if (!(sb = get_super(dev)))
+		panic("trying to preallocate on nonexistent device");
+	if (sb->s_reserved) {
+		n = count_map(sb,1,sb->s_reserved+count) - sb->s_reserved;
+		if (n < count)
+			count = n;
+	}
+	if (count <= 0)
+		return 0;
+	bit = block - (sb->s_firstdatazone-1);
+	if (!(bh = read_map(sb,1,bit>>13)))
+		return 0;
+	for (n=0 ; n<count ; n++) {
+		if (((bit+n+1) >> 13) != (bit >> 13) || block+n+1 >= sb->s_nzones)
+			break;
+		if (set_bit((bit+n+1)&8191,bh->b_data))
+			break;
+	}
+	if (n) {
+		mark_buffer_dirty(bh);
+		sb->s_zfree[bit>>13] -= n;
+		sb->s_free_zones -= n;
+	}
+	brelse(bh);
+	return n;
 }
 
 //// 释放指定的i节点
@@ -175,7 +405,7 @@ void free_inode(struct m_inode * inode)
 	if (!inode)
 		return;
 	if (!inode->i_dev) {
-		memset(inode,0,sizeof(*inode));
+		clear_inode(inode);
 		return;
 	}
     // 如果此i节点还有其他程序引用，则不能释放，说明内核有问题，停机。如果文件
@@ -191,20 +421,27 @@ void free_inode(struct m_inode * inode)
     // 范围是否正确，如果i节点号等于0或大于该设备上i节点总数，则出错(0号i节点
     // 保留没有使用)。如果该i节点对应的节点位图不存在，则出错。因为一个缓冲块
     // 的i节点位图有8192 bit。因此i_num>>13(即i_num/8192)可以得到当前i节点所在
-    // 的s_imap[]项，即所在盘块。
+    // 的i节点位图块。
 	if (!(sb = get_super(inode->i_dev)))
 		panic("trying to free inode on nonexistent device");
 	if (inode->i_num < 1 || inode->i_num > sb->s_ninodes)
 		panic("trying to free inode 0 or nonexistant inode");
-	if (!(bh=sb->s_imap[inode->i_num>>13]))
-		panic("nonexistent imap in superblock");
+	if (!(bh=read_map(sb,0,inode->i_num>>13))) {
+		printk("free_inode: can't read inode map, inode (%04x:%d) lost\n\r",
+			inode->i_dev,inode->i_num);
+		clear_inode(inode);
+		return;
+	}
     // 现在我们复位i节点对应的节点位图中的bit位。如果该bit位已经等于0，则显示
     // 出错警告信息。最后置i节点位图所在缓冲区已修改标志，并清空该i节点结构
     // 所占内存区。
 	if (clear_bit(inode->i_num&8191,bh->b_data))
 		printk("free_inode: bit already cleared.\n\r");
-	bh->b_dirt = 1;
-	memset(inode,0,sizeof(*inode));
+	mark_buffer_dirty(bh);
+	brelse(bh);
+	sb->s_ifree[inode->i_num>>13]++;
+	sb->s_free_inodes++;
+	clear_inode(inode);
 }
 
 //// 为设备dev建立一个新i节点。初始化并返回该新i节点的指针。
@@ -213,38 +450,29 @@ struct m_inode * new_inode(int dev)
 {
 	struct m_inode * inode;
 	struct super_block * sb;
-	struct buffer_head * bh;
-	int i,j;
+	int j;
 
     // 首先从内存i节点表(inode_table)中获取一个空闲i节点项，并读取指定设备的
-    // 超级块结构。然后扫描超级块中8块i节点位图，寻找首个0bit位，寻找空闲节点，
-    // 获取放置该i节点的节点号。如果全部扫描完还没找到，或者位图所在的缓冲块无效
-    // (bh=NULL),则放回先前申请的i节点表中的i节点，并返回NULL退出(没有空闲的i节点)。
+    // 超级块结构。然后在还有空闲位的i节点位图中取一个空闲bit位并置位，得到该i节点的
+    // 节点号。如果没有，则放回先前申请的i节点表中的i节点，并返回NULL退出(没有空闲的i节点)。
 	if (!(inode=get_empty_inode()))
 		return NULL;
 	if (!(sb = get_super(dev)))
 		panic("new_inode with unknown device");
-	j = 8192;
-	for (i=0 ; i<8 ; i++)
-		if ((bh=sb->s_imap[i]))
-			if ((j=find_first_zero(bh->b_data))<8192)
-				break;
-	if (!bh || j >= 8192 || j+i*8192 > sb->s_ninodes) {
+	if ((j = alloc_bit(sb,0,-1)) < 0) {
 		iput(inode);
 		return NULL;
 	}
-    // 现在我们已经找到了还未使用的i节点号j。于是置位i节点j对应的i节点位图相应bit位。
-    // 然后置i节点位图所在缓冲块已修改标志。最后初始化该i节点结构(i_ctime是i节点内容改变时间)。
-	if (set_bit(j,bh->b_data))
-		panic("new_inode: bit already set");
-	bh->b_dirt = 1;
+	sb->s_free_inodes--;
+    // 最后初始化该i节点结构(i_ctime是i节点内容改变时间)。
 	inode->i_count=1;                           // 引用计数
 	inode->i_nlinks=1;                          // 文件目录项连接数
 	inode->i_dev=dev;                           // i节点所在的设备号
 	inode->i_uid=current->euid;                 // i节点所属用户ID
 	inode->i_gid=current->egid;                 // 组id
-	inode->i_dirt=1;                            // 已修改标志置位
-	inode->i_num = j + i*8192;                  // 对应设备中的i节点号
+	mark_inode_dirty(inode);                    // 已修改标志置位
+	inode->i_num = j;                           // 对应设备中的i节点号
+	insert_inode_hash(inode);
 	inode->i_mtime = inode->i_atime = inode->i_ctime = CURRENT_TIME;
 	return inode;
 }
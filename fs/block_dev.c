@@ -5,6 +5,7 @@
  */
 
 #include <errno.h>
+#include <fcntl.h>
 
 #include <linux/sched.h>
 #include <linux/kernel.h>
@@ -19,7 +20,7 @@
 // 速缓冲管理程序决定并处理的。另外，因为块设备是以块为单位进行读写，因此对于写
 // 开始位置不处于块起始处时，需要先将开始字节所在的整个块读出，然后将需要写的数
 // 据从写开始处填写满该块，再将完整的一块数据写盘（即交由高速缓冲程序去处理）。
-int block_write(int dev, long * pos, char * buf, int count)
+int block_write(int dev, long * pos, char * buf, int count, int flags)
 {
     // 首先由文件中位置pos换算成开始读写盘快的块序号block，并求出需写第1字节在该
     // 块中的偏移位置offset.
@@ -30,6 +31,18 @@ int block_write(int dev, long * pos, char * buf, int count)
 	struct buffer_head * bh;
 	register char * p;                          // 局部寄存器变量，被存放在寄存器中
 
+    // O_DIRECT: 块对齐的整块部分直接从用户缓冲区写到设备上(参见buffer.c中的direct_io())。
+	if ((flags & O_DIRECT) && !offset && !((unsigned long) buf & (BLOCK_SIZE-1))
+	    && (chars = count & ~(BLOCK_SIZE-1))) {
+		written = direct_io(WRITE,dev,block,chars>>BLOCK_SIZE_BITS,buf);
+		*pos += written;
+		if (written < chars)
+			return written?written:-EIO;
+		block += chars>>BLOCK_SIZE_BITS;
+		buf += chars;
+		count -= chars;
+	}
+
     // 然后针对要写入的字节数count，循环执行以下操作，知道数据全部写入。在循环执行
     // 过程中，先计算在当前处理的数据块中可写入的字节数。如果写入的字节数填不满一块，
     // 那么就只需写count字节。如果正要写1块数据内容，则直接申请1块高速缓冲块，并把
@@ -58,9 +71,9 @@ int block_write(int dev, long * pos, char * buf, int count)
 		*pos += chars;
 		written += chars;           // 累计写入字节数
 		count -= chars;
-		while (chars-->0)
-			*(p++) = get_fs_byte(buf++);
-		bh->b_dirt = 1;
+		copy_from_user(p,buf,chars);
+		buf += chars;
+		mark_buffer_dirty(bh);
 		brelse(bh);
 	}
 	return written;
@@ -70,7 +83,7 @@ int block_write(int dev, long * pos, char * buf, int count)
 // 参数：dev - 设备号；pos - 设备文件中偏移量指针；buf - 用户空间缓冲区地址；
 // count - 要传送的字节数。
 // 返回已读入字节数。若没有读入任何字节或出错，则返回出错号。
-int block_read(int dev, unsigned long * pos, char * buf, int count)
+int block_read(int dev, unsigned long * pos, char * buf, int count, int flags)
 {
     // 首先由文件中位置pos换算成开始读写盘块的块序号block，并求出需读第1个字节在块中
     // 的偏移位置offset.
@@ -81,6 +94,18 @@ int block_read(int dev, unsigned long * pos, char * buf, int count)
 	struct buffer_head * bh;
 	register char * p;
 
+    // O_DIRECT: 块对齐的整块部分直接从设备读到用户缓冲区中。
+	if ((flags & O_DIRECT) && !offset && !((unsigned long) buf & (BLOCK_SIZE-1))
+	    && (chars = count & ~(BLOCK_SIZE-1))) {
+		read = direct_io(READ,dev,block,chars>>BLOCK_SIZE_BITS,buf);
+		*pos += read;
+		if (read < chars)
+			return read?read:-EIO;
+		block += chars>>BLOCK_SIZE_BITS;
+		buf += chars;
+		count -= chars;
+	}
+
     // 然后针对要读入的字节数count，循环执行以下操作，直到数据全部读入。在循环执行
     // 过程中，先计算在当前处理的数据块中需读入的字节数。如果需要读入的字节数还不满
     // 一块，那么就只需要读count字节。然后调用读块函数breada()读如需要的数据块，并
@@ -105,8 +130,8 @@ int block_read(int dev, unsigned long * pos, char * buf, int count)
 		*pos += chars;
 		read += chars;                      // 读入累计字节数
 		count -= chars;
-		while (chars-->0)
-			put_fs_byte(*(p++),buf++);
+		copy_to_user(buf,p,chars);
+		buf += chars;
 		brelse(bh);
 	}
 	return read;
@@ -19,12 +19,17 @@
  */
 
 #include <stdarg.h>
+#include <string.h>
  
+#include <errno.h>
+
 #include <linux/config.h>
 #include <linux/sched.h>
 #include <linux/kernel.h>
 #include <asm/system.h>
 #include <asm/io.h>
+#include <asm/segment.h>
+#include <sys/iostat.h>
 
 // 变量end是由编译时的连接程序ld生成，用于表明内核代码的末端，即指明内核模块某段位置。
 // 也可以从编译内核时生成的System.map文件中查出。这里用它来表明高速缓冲区开始于内核
@@ -36,16 +41,108 @@
 extern int end;
 extern void put_super(int);
 extern void invalidate_inodes(int);
+extern struct iostat io_stat;
+extern int nr_free_pages;
 
 struct buffer_head * start_buffer = (struct buffer_head *) &end;
-struct buffer_head * hash_table[NR_HASH];           // NR_HASH ＝ 307项
-static struct buffer_head * free_list;              // 空闲缓冲块链表头指针
+
+/*
+ * Replacement is 2Q: a buffer that is read in goes to the A1in list,
+ * which is a FIFO, and is taken from its head when A1in has more than
+ * its share (KIN) of the buffers. A block that was thrown out of A1in
+ * is remembered for a while in the A1out ghost list (only dev/block,
+ * no data). If it is wanted again while still there, it has proven to
+ * be hot, and goes to the Am list, which is LRU. So one big sequential
+ * read only cycles through A1in, and doesn't push out the metadata
+ * blocks in Am. Both lists are circular, like the old free list was.
+ */
+#define BUF_A1IN	0
+#define BUF_AM		1
+#define KIN		(NR_BUFFERS/4)
+#define KOUT		(NR_BUFFERS/2 < NR_GHOST ? NR_BUFFERS/2 : NR_GHOST)
+
+#define BUF_UNUSED	2		/* head not in use, on unused_list */
+
+static struct buffer_head * lru_list[2] = {NULL, NULL};
+static int nr_list[2] = {0, 0};
+
+/*
+ * The buffers set up by buffer_init() are always there. When getblk()
+ * needs a buffer, more are made a page (4 buffers) at a time from free
+ * memory, up to bdf_maxbuf buffers and as long as more than twice
+ * bdf_reserve pages are free. When free pages drop below bdf_reserve,
+ * get_free_page() calls shrink_buffers(), which gives back pages whose
+ * buffers are all unused and clean (but not below bdf_minbuf buffers).
+ * The buffers of one page are linked through b_this_page. Heads come
+ * from pages of their own and are never given back: unused ones are
+ * kept on unused_list. all_buffers links every buffer in use, both
+ * ways, so that a freed page's buffers come off it at once.
+ */
+static struct buffer_head * all_buffers = NULL;
+static struct buffer_head * unused_list = NULL;
+static int nr_unused = 0;
+
+/*
+ * Buffers that hold a block are also on a list for their device, and
+ * dirty ones on a second one, so that syncing or invalidating a device
+ * doesn't have to look at the whole cache. Devices are hashed into
+ * NR_DEVLISTS lists, so there may be others on the same one.
+ */
+#define NR_DEVLISTS	16
+#define devlist(dev)	(((dev) ^ ((dev) >> 8)) & (NR_DEVLISTS-1))
+
+static struct buffer_head * dev_buffers[NR_DEVLISTS];
+static struct buffer_head * dev_dirty[NR_DEVLISTS];
+
+#define NR_GHOST	512
+#define GHOST_BITS	7
+#define GHOST_HASH	(1 << GHOST_BITS)
+
+static struct ghost {
+	unsigned short g_dev;		/* 0 - unused slot */
+	unsigned long g_block;
+	short g_next, g_prev;		/* hash chain, -1 ends it */
+} ghost[NR_GHOST];
+static short ghost_hash[GHOST_HASH];
+static int ghost_head = 0, ghost_count = 0;
 static struct task_struct * buffer_wait = NULL;     // 等待空闲缓冲块而睡眠的任务队列
 // 下面定义系统缓冲区中含有的缓冲块个数。这里，NR_BUFFERS是一个定义在linux/fs.h中的
 // 宏，其值即使变量名nr_buffers，并且在fs.h文件中声明为全局变量。大写名称通常都是一个
 // 宏名称，Linus这样编写代码是为了利用这个大写名称来隐含地表示nr_buffers是一个在内核
 // 初始化之后不再改变的“变量”。它将在后面的缓冲区初始化函数buffer_init中被设置。
 int NR_BUFFERS = 0;                                 // 系统含有缓冲区块的个数
+int nr_buffers_dirty = 0;
+
+/*
+ * The flusher: a process forked by init() that lives in sys_bdflush(0).
+ * It runs every bdf_interval ticks, and whenever more than bdf_nfract
+ * percent of the buffers are dirty. It writes out, in block order, up to
+ * bdf_ndirty buffers that have been dirty for longer than bdf_age - or
+ * any dirty buffers at all, if there are too many of them. Before that,
+ * file data that has been waiting for blocks for bdf_age gets them.
+ */
+#define NR_BDPARAM	7
+#define MAX_FLUSH	256
+
+static long bdf_prm[NR_BDPARAM] = {40, 64, 5*HZ, 30*HZ, 0, 4096, 64};
+static long bdf_min[NR_BDPARAM] = {1, 1, HZ/10, 0, 0, 0, 0};
+static long bdf_max[NR_BDPARAM] = {100, MAX_FLUSH, 600*HZ, 600*HZ,
+	16384, 16384, 1024};
+
+#define bdf_nfract	bdf_prm[0]	/* percent dirty that wakes it up */
+#define bdf_ndirty	bdf_prm[1]	/* max buffers per pass */
+#define bdf_interval	bdf_prm[2]	/* ticks between runs */
+#define bdf_age		bdf_prm[3]	/* ticks a buffer may stay dirty */
+#define bdf_minbuf	bdf_prm[4]	/* don't shrink below this many buffers */
+#define bdf_maxbuf	bdf_prm[5]	/* don't grow above this many */
+#define bdf_reserve	bdf_prm[6]	/* free pages to leave for others */
+
+#define TOO_MANY_DIRTY (nr_buffers_dirty*100 > bdf_nfract*NR_BUFFERS)
+
+static struct task_struct * bdflush_wait = NULL;
+static struct task_struct * bdflush_task = NULL;
+static int bdflush_timer = 0;
+static struct buffer_head * flush_list[MAX_FLUSH];
 
 //// 等待指定缓冲块解锁
 // 如果指定的缓冲块bh已经上锁就让进程不可中断地睡眠在该缓冲块的等待队列b_wait中。
@@ -61,63 +158,122 @@ static inline void wait_on_buffer(struct buffer_head * bh)
 	sti();                          // 开中断
 }
 
+static inline void unpark_buffer(struct buffer_head * bh);
+
+void mark_buffer_dirty(struct buffer_head * bh)
+{
+	struct buffer_head ** p;
+
+	if (bh->b_dirt)
+		return;
+	bh->b_dirt = 1;
+	bh->b_dirtime = jiffies;
+	nr_buffers_dirty++;
+	p = dev_dirty + devlist(bh->b_dev);
+	bh->b_prev_dirty = NULL;
+	if ((bh->b_next_dirty = *p))
+		bh->b_next_dirty->b_prev_dirty = bh;
+	*p = bh;
+	if (bdflush_wait && TOO_MANY_DIRTY)
+		wake_up(&bdflush_wait);
+}
+
+void clear_buffer_dirty(struct buffer_head * bh)
+{
+	if (!bh->b_dirt)
+		return;
+	bh->b_dirt = 0;
+	nr_buffers_dirty--;
+	if (bh->b_next_dirty)
+		bh->b_next_dirty->b_prev_dirty = bh->b_prev_dirty;
+	if (bh->b_prev_dirty)
+		bh->b_prev_dirty->b_next_dirty = bh->b_next_dirty;
+	else
+		dev_dirty[devlist(bh->b_dev)] = bh->b_next_dirty;
+	bh->b_next_dirty = bh->b_prev_dirty = NULL;
+	unpark_buffer(bh);
+}
+
+#define BLOCK_BEFORE(a,b) ((a)->b_dev < (b)->b_dev || \
+((a)->b_dev == (b)->b_dev && (a)->b_blocknr < (b)->b_blocknr))
+
+/*
+ * write_dirty() writes out the dirty buffers of dev (of all devices if
+ * dev is 0) in block order, NR_SYNC at a time: each pass takes the
+ * lowest ones after where the last pass ended. Buffers dirtied behind
+ * that meanwhile are left for the next time.
+ */
+#define NR_SYNC 64
+
+static void write_dirty(int dev)
+{
+	struct buffer_head * bh, * list[NR_SYNC];
+	unsigned short from_dev = 0;
+	unsigned long from_block = 0;
+	int i, j, n, first = 0, last = NR_DEVLISTS;
+
+	if (dev) {
+		first = devlist(dev);
+		last = first+1;
+	}
+	do {
+		n = 0;
+		for (i = first ; i < last ; i++)
+			for (bh = dev_dirty[i] ; bh ; bh = bh->b_next_dirty) {
+				if (dev && bh->b_dev != dev)
+					continue;
+				if (bh->b_dev < from_dev || (bh->b_dev == from_dev &&
+				    bh->b_blocknr < from_block))
+					continue;
+				if (n == NR_SYNC && !BLOCK_BEFORE(bh,list[n-1]))
+					continue;
+				if (n < NR_SYNC)
+					n++;
+				for (j = n-1 ; j > 0 && BLOCK_BEFORE(bh,list[j-1]) ; j--)
+					list[j] = list[j-1];
+				list[j] = bh;
+			}
+		if (!n)
+			break;
+		for (i=0 ; i<n ; i++)
+			list[i]->b_count++;
+		from_dev = list[n-1]->b_dev;
+		from_block = list[n-1]->b_blocknr+1;
+		for (i=0 ; i<n ; i++) {
+			ll_rw_block(WRITE,list[i]);
+			put_buffer(list[i]);
+		}
+	} while (n == NR_SYNC);
+}
+
 //// 设备数据同步。
 // 同步设备和内存高速缓冲中数据，其中sync_inode()定义在inode.c中。
 int sys_sync(void)
 {
-	int i;
-	struct buffer_head * bh;
-
     // 首先调用i节点同步函数，把内存i节点表中所有修改过的i节点写入高速缓冲中。
-    // 然后扫描所有高速缓冲区，对已被修改的缓冲块产生写盘请求，将缓冲中数据写入
-    // 盘中，做到高速缓冲中的数据与设备中的同步。
+    // 然后对所有已被修改的缓冲块按块号顺序产生写盘请求，将缓冲中数据写入盘中，
+    // 做到高速缓冲中的数据与设备中的同步。
+	sync_delayed(0);	/* give delayed data its blocks */
 	sync_inodes();		/* write out inodes into buffers */
-	bh = start_buffer;
-	for (i=0 ; i<NR_BUFFERS ; i++,bh++) {
-		wait_on_buffer(bh);                 // 等待缓冲区解锁(如果已经上锁的话)
-		if (bh->b_dirt)
-			ll_rw_block(WRITE,bh);          // 产生写设备块请求
-	}
+	write_dirty(0);
+	wake_up(&buffer_wait);
 	return 0;
 }
 
 //// 对指定设备进行高速缓冲数据与设备上数据的同步操作
-// 该函数首先搜索高速缓冲区所有缓冲块。对于指定设备dev的缓冲块，若其数据已经
-// 被修改过就写入盘中(同步操作)。然后把内存中i节点表数据写入 高速缓冲中。之后
-// 再对指定设备dev执行一次与上述相同的写盘操作。
+// 该函数首先把指定设备dev的已修改缓冲块写入盘中(同步操作)。然后把内存中i节点表
+// 数据写入高速缓冲中。之后再对指定设备dev执行一次与上述相同的写盘操作。只需查看
+// 该设备的脏缓冲块链表，而不用扫描整个高速缓冲区。
 int sync_dev(int dev)
 {
-	int i;
-	struct buffer_head * bh;
-
-    // 首先对参数指定的设备执行数据同步操作，让设备上的数据与高速缓冲区中的数据
-    // 同步。方法是扫描高速缓冲区中所有缓冲块，对指定设备dev的缓冲块，先检测其
-    // 是否已被上锁，若已被上锁就睡眠等待其解锁。然后再判断一次该缓冲块是否还是
-    // 指定设备的缓冲块并且已修改过(b_dirt标志置位)，若是就对其执行写盘操作。
-    // 因为在我们睡眠期间该缓冲块有可能已被释放或者被挪作他用，所以在继续执行前
-    // 需要再次判断一下该缓冲块是否还是指定设备的缓冲块。
-	bh = start_buffer;
-	for (i=0 ; i<NR_BUFFERS ; i++,bh++) {
-		if (bh->b_dev != dev)               // 不是设备dev的缓冲块则继续
-			continue;
-		wait_on_buffer(bh);                     // 等待缓冲区解锁
-		if (bh->b_dev == dev && bh->b_dirt)
-			ll_rw_block(WRITE,bh);
-	}
-    // 再将i节点数据吸入高速缓冲。让i姐电表inode_table中的inode与缓冲中的信息同步。
+	write_dirty(dev);
+    // 再将i节点数据写入高速缓冲。然后在高速缓冲中的数据更新之后，再把他们与设备中的
+    // 数据同步。这里采用两遍同步操作是为了提高内核执行效率。第一遍缓冲区同步操作可以
+    // 让内核中许多"脏快"变干净，使得i节点的同步操作能够高效执行。本次缓冲区同步操作
+    // 则把那些由于i节点同步操作而又变脏的缓冲块与设备中数据同步。
 	sync_inodes();
-    // 然后在高速缓冲中的数据更新之后，再把他们与设备中的数据同步。这里采用两遍同步
-    // 操作是为了提高内核执行效率。第一遍缓冲区同步操作可以让内核中许多"脏快"变干净，
-    // 使得i节点的同步操作能够高效执行。本次缓冲区同步操作则把那些由于i节点同步操作
-    // 而又变脏的缓冲块与设备中数据同步。
-	bh = start_buffer;
-	for (i=0 ; i<NR_BUFFERS ; i++,bh++) {
-		if (bh->b_dev != dev)
-			continue;
-		wait_on_buffer(bh);
-		if (bh->b_dev == dev && bh->b_dirt)
-			ll_rw_block(WRITE,bh);
-	}
+	write_dirty(dev);
+	wake_up(&buffer_wait);
 	return 0;
 }
 
@@ -125,19 +281,23 @@ int sync_dev(int dev)
 // 扫描高速缓冲区中所有缓冲块，对指定设备的缓冲块复位其有效(更新)标志和已修改标志
 void inline invalidate_buffers(int dev)
 {
-	int i;
-	struct buffer_head * bh;
+	struct buffer_head * bh, * next;
 
-	bh = start_buffer;
-	for (i=0 ; i<NR_BUFFERS ; i++,bh++) {
-        // 如果不是指定设备的缓冲块，则继续扫描下一块
-		if (bh->b_dev != dev)
-			continue;
-		wait_on_buffer(bh);
-        // 由于进程执行过程睡眠等待，所以需要再判断一下缓冲区是否是指定设备的。
-		if (bh->b_dev == dev)
-			bh->b_uptodate = bh->b_dirt = 0;
+	for (bh = dev_buffers[devlist(dev)] ; bh ; bh = next) {
+		bh->b_count++;
+        // 只处理指定设备的缓冲块
+		if (bh->b_dev == dev) {
+			wait_on_buffer(bh);
+            // 由于进程执行过程睡眠等待，所以需要再判断一下缓冲区是否是指定设备的。
+			if (bh->b_dev == dev) {
+				bh->b_uptodate = 0;
+				clear_buffer_dirty(bh);
+			}
+		}
+		next = bh->b_next_dev;
+		put_buffer(bh);
 	}
+	wake_up(&buffer_wait);
 }
 
 /*
@@ -174,21 +334,209 @@ void check_disk_change(int dev)
 	invalidate_buffers(dev);
 }
 
-// 下面两行代码是hash（散列）函数定义和Hash表项的计算宏
-// hash表的主要作用是减少查找比较元素所花费的时间。通过在元素的存储位置与关
-// 键字之间建立一个对应关系(hash函数)，我们就可以直接通过函数计算立刻查询到指定
-// 的元素。建立hash函数的指导条件主要是尽量确保散列在任何数组项的概率基本相等。
-// 建立函数的方法有多种，这里Linux-0.11主要采用了关键字除留余数法。因为我们
-// 寻找的缓冲块有两个条件，即设备号dev和缓冲块号block，因此设计的hash函数肯定
-// 需要包含这两个关键值。这两个关键字的异或操作只是计算关键值的一种方法。再对
-// 关键值进行MOD运算就可以保证函数所计算得到的值都处于函数数组项范围内。
-#define _hashfn(dev,block) (((unsigned)(dev^block))%NR_HASH)
-#define hash(dev,block) hash_table[_hashfn(dev,block)]
+/*
+ * The hash is multiplicative: (dev,block) times a constant near 2^32
+ * divided by the golden ratio, and the top bits of the product pick the
+ * bucket. Unlike dev^block, that spreads the blocks of different minors
+ * too. The table has 2^bits buckets, sized at buffer_init() from the
+ * number of buffers, and kept in pages of 1024 buckets.
+ *
+ * When the cache has grown to more than twice as many buffers as there
+ * are buckets, grow_buffers() allocates a table of twice the size, and
+ * from then on every insert moves a few old buckets over. Old bucket b
+ * goes to new buckets 2b and 2b+1. Until it has been moved, lookups of
+ * blocks that hash to it go to the old table, so nothing ever has to
+ * wait for the whole table to be rehashed.
+ */
+#define HASHVAL(dev,block) \
+((((unsigned long) (dev) << 16) ^ (unsigned long) (block)) * 0x9E370001UL)
+#define MIN_HASH_BITS	8
+#define MAX_HASH_BITS	13
+#define HASH_PAGES	(1 << (MAX_HASH_BITS-10))
+#define MIGRATE_STEP	4
+
+static struct hash_tab {
+	int bits;
+	struct buffer_head ** page[HASH_PAGES];
+} hash_cur, hash_old;
+static int hash_split = -1;		/* next old bucket to move, -1 - none */
+
+#define BUCKET(t,i) ((t)->page[(i)>>10][(i)&1023])
+#define HASH_PAGES_OF(t) ((t)->bits > 10 ? 1 << ((t)->bits-10) : 1)
+
+static struct buffer_head ** hash_bucket(int dev, int block)
+{
+	unsigned long h = HASHVAL(dev,block);
+	unsigned long i;
+
+	if (hash_split >= 0) {
+		i = h >> (32 - hash_old.bits);
+		if (i >= hash_split)
+			return &BUCKET(&hash_old,i);
+	}
+	i = h >> (32 - hash_cur.bits);
+	return &BUCKET(&hash_cur,i);
+}
+
+static void hash_migrate(int n)
+{
+	struct buffer_head * bh, ** p;
+	int i;
+
+	while (hash_split >= 0 && n--) {
+		while ((bh = BUCKET(&hash_old,hash_split))) {
+			BUCKET(&hash_old,hash_split) = bh->b_next;
+			p = &BUCKET(&hash_cur,
+				HASHVAL(bh->b_dev,bh->b_blocknr) >> (32 - hash_cur.bits));
+			bh->b_prev = NULL;
+			if ((bh->b_next = *p))
+				bh->b_next->b_prev = bh;
+			*p = bh;
+		}
+		if (++hash_split < (1 << hash_old.bits))
+			continue;
+		for (i = 0 ; i < HASH_PAGES_OF(&hash_old) ; i++)
+			free_page((unsigned long) hash_old.page[i]);
+		hash_split = -1;
+	}
+}
+
+static int alloc_hash(struct hash_tab * t, int bits)
+{
+	int i;
+
+	t->bits = bits;
+	for (i = 0 ; i < HASH_PAGES_OF(t) ; i++)
+		if (!(t->page[i] = (struct buffer_head **) get_free_page())) {
+			while (i--)
+				free_page((unsigned long) t->page[i]);
+			return 0;
+		}
+	io_stat.hash_buckets = 1 << bits;
+	return 1;
+}
+
+/* start doubling the hash table, if it's getting crowded */
+static void hash_grow(void)
+{
+	struct hash_tab new;
+
+	if (hash_split >= 0 || hash_cur.bits >= MAX_HASH_BITS ||
+	    NR_BUFFERS <= 2 << hash_cur.bits)
+		return;
+	if (!alloc_hash(&new,hash_cur.bits+1))
+		return;
+	hash_old = hash_cur;
+	hash_cur = new;
+	hash_split = 0;
+}
+
+#define _ghashfn(dev,block) (HASHVAL(dev,block) >> (32 - GHOST_BITS))
+
+static void ghost_unlink(int i)
+{
+	struct ghost * g = ghost + i;
+
+	if (g->g_next >= 0)
+		ghost[g->g_next].g_prev = g->g_prev;
+	if (g->g_prev >= 0)
+		ghost[g->g_prev].g_next = g->g_next;
+	else
+		ghost_hash[_ghashfn(g->g_dev,g->g_block)] = g->g_next;
+	g->g_dev = 0;
+}
+
+/* remember a block that is thrown out of A1in, forgetting the oldest */
+static void ghost_add(int dev, int block)
+{
+	struct ghost * g;
+	int i;
+
+	while (ghost_count && ghost_count >= KOUT) {
+		i = ghost_head;
+		ghost_head = (ghost_head+1) % NR_GHOST;
+		ghost_count--;
+		if (ghost[i].g_dev)
+			ghost_unlink(i);
+	}
+	i = (ghost_head + ghost_count++) % NR_GHOST;
+	g = ghost + i;
+	g->g_dev = dev;
+	g->g_block = block;
+	g->g_prev = -1;
+	g->g_next = ghost_hash[_ghashfn(dev,block)];
+	if (g->g_next >= 0)
+		ghost[g->g_next].g_prev = i;
+	ghost_hash[_ghashfn(dev,block)] = i;
+}
+
+/* is the block in A1out? If so, it's taken out: it gets a buffer now */
+static int ghost_find(int dev, int block)
+{
+	int i;
+
+	for (i = ghost_hash[_ghashfn(dev,block)] ; i >= 0 ; i = ghost[i].g_next)
+		if (ghost[i].g_dev == dev && ghost[i].g_block == block) {
+			ghost_unlink(i);
+			return 1;
+		}
+	return 0;
+}
+
+static inline void remove_from_list(struct buffer_head * bh)
+{
+	if (bh->b_parked) {
+		bh->b_parked = 0;
+		return;
+	}
+	if (!(bh->b_prev_free) || !(bh->b_next_free))
+		panic("Free block list corrupted");
+	bh->b_prev_free->b_next_free = bh->b_next_free;
+	bh->b_next_free->b_prev_free = bh->b_prev_free;
+	if (lru_list[bh->b_list] == bh)
+		lru_list[bh->b_list] = bh->b_next_free;
+	if (lru_list[bh->b_list] == bh)
+		lru_list[bh->b_list] = NULL;
+	nr_list[bh->b_list]--;
+}
+
+static inline void put_last_on_list(struct buffer_head * bh)
+{
+	struct buffer_head * head = lru_list[bh->b_list];
+
+	if (!head) {
+		lru_list[bh->b_list] = bh->b_next_free = bh->b_prev_free = bh;
+	} else {
+		bh->b_next_free = head;
+		bh->b_prev_free = head->b_prev_free;
+		head->b_prev_free->b_next_free = bh;
+		head->b_prev_free = bh;
+	}
+	nr_list[bh->b_list]++;
+}
+
+/*
+ * A buffer that is held or dirty can't be reused. get_free_buffer()
+ * takes such a buffer off its 2Q list when it finds it at the head
+ * ("parks" it), so that the list heads are always ones it can take.
+ * unpark_buffer() puts it back at the tail when it is free and clean
+ * again: brelse(), put_buffer() and clear_buffer_dirty() call it.
+ */
+static inline void unpark_buffer(struct buffer_head * bh)
+{
+	if (bh->b_parked && !bh->b_count && !bh->b_dirt) {
+		bh->b_parked = 0;
+		put_last_on_list(bh);
+		wake_up(&buffer_wait);
+	}
+}
 
 //// 从hash队列和空闲缓冲区队列中移走缓冲块。
 // hash队列是双向链表结构，空闲缓冲块队列是双向循环链表结构。
 static inline void remove_from_queues(struct buffer_head * bh)
 {
+	struct buffer_head ** p;
+
 /* remove from hash-queue */
 	if (bh->b_next)
 		bh->b_next->b_prev = bh->b_prev;
@@ -196,37 +544,47 @@ static inline void remove_from_queues(struct buffer_head * bh)
 		bh->b_prev->b_next = bh->b_next;
     // 如果该缓冲区是该队列的头一个块，则让hash表的对应项指向本队列中的下一个
     // 缓冲区。
-	if (hash(bh->b_dev,bh->b_blocknr) == bh)
-		hash(bh->b_dev,bh->b_blocknr) = bh->b_next;
-/* remove from free list */
-	if (!(bh->b_prev_free) || !(bh->b_next_free))
-		panic("Free block list corrupted");
-	bh->b_prev_free->b_next_free = bh->b_next_free;
-	bh->b_next_free->b_prev_free = bh->b_prev_free;
-    // 如果空闲链表头指向本缓冲区，则让其指向下一缓冲区。
-	if (free_list == bh)
-		free_list = bh->b_next_free;
+	p = hash_bucket(bh->b_dev,bh->b_blocknr);
+	if (*p == bh)
+		*p = bh->b_next;
+/* remove from its device list */
+	if (bh->b_dev) {
+		if (bh->b_next_dev)
+			bh->b_next_dev->b_prev_dev = bh->b_prev_dev;
+		if (bh->b_prev_dev)
+			bh->b_prev_dev->b_next_dev = bh->b_next_dev;
+		else
+			dev_buffers[devlist(bh->b_dev)] = bh->b_next_dev;
+		bh->b_next_dev = bh->b_prev_dev = NULL;
+	}
+/* remove from its 2Q list */
+	remove_from_list(bh);
 }
 
 //// 将缓冲块插入空闲链表尾部，同时放入hash队列中。
 static inline void insert_into_queues(struct buffer_head * bh)
 {
-/* put at end of free list */
-	bh->b_next_free = free_list;
-	bh->b_prev_free = free_list->b_prev_free;
-	free_list->b_prev_free->b_next_free = bh;
-	free_list->b_prev_free = bh;
+	struct buffer_head ** p;
+
+/* put at end of its 2Q list */
+	put_last_on_list(bh);
 /* put the buffer in new hash-queue if it has a device */
-    // 请注意当hash表某项第1次插入项时，hash()计算值肯定为Null，因此此时得到
-    // 的bh->b_next肯定是NULL，所以应该在bh->b_next不为NULL时才能给b_prev赋
-    // bh值。
 	bh->b_prev = NULL;
 	bh->b_next = NULL;
 	if (!bh->b_dev)
 		return;
-	bh->b_next = hash(bh->b_dev,bh->b_blocknr);
-	hash(bh->b_dev,bh->b_blocknr) = bh;
-	bh->b_next->b_prev = bh;                // 此句前应添加"if (bh->b_next)"判断
+	p = hash_bucket(bh->b_dev,bh->b_blocknr);
+	bh->b_next = *p;
+	*p = bh;
+	if (bh->b_next)
+		bh->b_next->b_prev = bh;
+/* ... and on its device list */
+	p = dev_buffers + devlist(bh->b_dev);
+	bh->b_prev_dev = NULL;
+	if ((bh->b_next_dev = *p))
+		bh->b_next_dev->b_prev_dev = bh;
+	*p = bh;
+	hash_migrate(MIGRATE_STEP);
 }
 
 //// 利用hash表在高速缓冲区中寻找给定设备和指定块号的缓冲区块。
@@ -234,12 +592,19 @@ static inline void insert_into_queues(struct buffer_head * bh)
 static struct buffer_head * find_buffer(int dev, int block)
 {		
 	struct buffer_head * tmp;
+	unsigned long n = 0;
 
     // 搜索hash表，寻找指定设备号和块号的缓冲块。
-	for (tmp = hash(dev,block) ; tmp != NULL ; tmp = tmp->b_next)
+	io_stat.hash_lookups++;
+	for (tmp = *hash_bucket(dev,block) ; tmp != NULL ; tmp = tmp->b_next) {
+		n++;
 		if (tmp->b_dev==dev && tmp->b_blocknr==block)
-			return tmp;
-	return NULL;
+			break;
+	}
+	io_stat.hash_probes += n;
+	if (n > io_stat.hash_maxchain)
+		io_stat.hash_maxchain = n;
+	return tmp;
 }
 
 /*
@@ -263,11 +628,16 @@ struct buffer_head * get_hash_table(int dev, int block)
         // 因此有必要在验证该缓冲块的正确性，并返回缓冲块头指针。
 		bh->b_count++;
 		wait_on_buffer(bh);
-		if (bh->b_dev == dev && bh->b_blocknr == block)
+		if (bh->b_dev == dev && bh->b_blocknr == block) {
+			if (bh->b_list == BUF_AM && !bh->b_parked) {
+				remove_from_list(bh);
+				put_last_on_list(bh);
+			}
 			return bh;
+		}
         // 如果在睡眠时该缓冲块所属的设备号或块设备号发生了改变，则撤消对它的
         // 引用计数，重新寻找。
-		bh->b_count--;
+		put_buffer(bh);
 	}
 }
 
@@ -278,65 +648,208 @@ struct buffer_head * get_hash_table(int dev, int block)
  *
  * The algoritm is changed: hopefully better, and an elusive bug removed.
  */
-// 下面宏用于同时判断缓冲区的修改标志和锁定标志，并且定义修改标志的权重要比锁定标志大。
-#define BADNESS(bh) (((bh)->b_dirt<<1)+(bh)->b_lock)
-//// 取高速缓冲中指定的缓冲块
-// 检查指定（设备号和块号）的缓冲区是否已经在高速缓冲中。如果指定块已经在
-// 高速缓冲中，则返回对应缓冲区头指针退出；如果不在，就需要在高速缓冲中设置一个
-// 对应设备号和块好的新项。返回相应的缓冲区头指针。
-struct buffer_head * getblk(int dev,int block)
+/*
+ * get_more_heads() fills unused_list from a fresh page.
+ */
+static int get_more_heads(void)
 {
-	struct buffer_head * tmp, * bh;
+	struct buffer_head * bh;
+	unsigned long page;
+
+	if (!(page = get_free_page()))
+		return 0;
+	for (bh = (struct buffer_head *) page ;
+	     (unsigned long) (bh+1) <= page+PAGE_SIZE ; bh++) {
+		bh->b_list = BUF_UNUSED;
+		bh->b_next_free = unused_list;
+		unused_list = bh;
+		nr_unused++;
+	}
+	return 1;
+}
+
+/*
+ * grow_buffers() makes PAGE_SIZE/BLOCK_SIZE new, empty buffers and puts
+ * them at the head of A1in, so they are the next ones to be used.
+ */
+static void grow_buffers(void)
+{
+	struct buffer_head * bh, * prev = NULL, * first = NULL;
+	unsigned long page;
+	int i;
+
+	if (nr_unused < PAGE_SIZE/BLOCK_SIZE && !get_more_heads())
+		return;
+	if (!(page = get_free_page()))
+		return;
+	for (i = 0 ; i < PAGE_SIZE/BLOCK_SIZE ; i++) {
+		bh = unused_list;
+		unused_list = bh->b_next_free;
+		nr_unused--;
+		bh->b_dev = 0;
+		bh->b_dirt = 0;
+		bh->b_count = 0;
+		bh->b_lock = 0;
+		bh->b_uptodate = 0;
+		bh->b_wait = NULL;
+		bh->b_next = NULL;
+		bh->b_prev = NULL;
+		bh->b_reqnext = NULL;
+		bh->b_delay = 0;
+		bh->b_next_delay = NULL;
+		bh->b_next_dev = bh->b_prev_dev = NULL;
+		bh->b_next_dirty = bh->b_prev_dirty = NULL;
+		bh->b_data = (char *) page + i*BLOCK_SIZE;
+		bh->b_list = BUF_A1IN;
+		bh->b_parked = 0;
+		put_last_on_list(bh);
+		lru_list[BUF_A1IN] = bh;
+		bh->b_prev_all = NULL;
+		if ((bh->b_next_all = all_buffers))
+			all_buffers->b_prev_all = bh;
+		all_buffers = bh;
+		if (!first)
+			first = bh;
+		bh->b_this_page = prev;
+		prev = bh;
+		NR_BUFFERS++;
+	}
+	first->b_this_page = prev;
+	io_stat.bc_grown++;
+	hash_grow();
+}
+
+/*
+ * free_buffer_page() gives back the page of 'bh' if none of its
+ * buffers is in use, dirty or locked. It can't sleep: it is called
+ * from get_free_page().
+ */
+static int free_buffer_page(struct buffer_head * bh)
+{
+	struct buffer_head * tmp = bh;
+	unsigned long page = (unsigned long) bh->b_data & 0xfffff000;
 
-repeat:
-    // 搜索hash表，如果指定块已经在高速缓冲中，则返回对应缓冲区头指针，退出。
-	if ((bh = get_hash_table(dev,block)))
-		return bh;
-    // 扫描空闲数据块链表，寻找空闲缓冲区。
-    // 首先让tmp指向空闲链表的第一个空闲缓冲区头
-	tmp = free_list;
 	do {
-        // 如果该缓冲区正被使用（引用计数不等于0），则继续扫描下一项。对于
-        // b_count = 0的块，即高速缓冲中当前没有引用的块不一定就是干净的
-        // (b_dirt=0)或没有锁定的(b_lock=0)。因此，我们还是需要继续下面的判断
-        // 和选择。例如当一个任务该写过一块内容后就释放了，于是该块b_count()=0
-        // 但b_lock不等于0；当一个任务执行breada()预读几个块时，只要ll_rw_block()
-        // 命令发出后，它就会递减b_count; 但此时实际上硬盘访问操作可能还在进行，
-        // 因此此时b_lock=1, 但b_count=0.
-		if (tmp->b_count)
-			continue;
-        // 如果缓冲头指针bh为空，或者tmp所指缓冲头的标志(修改、锁定)权重小于bh
-        // 头标志的权重，则让bh指向tmp缓冲块头。如果该tmp缓冲块头表明缓冲块既
-        // 没有修改也没有锁定标志置位，则说明已为指定设备上的块取得对应的高速
-        // 缓冲块，则退出循环。否则我们就继续执行本循环，看看能否找到一个BANDNESS()
-        // 最小的缓冲块。
-		if (!bh || BADNESS(tmp)<BADNESS(bh)) {
-			bh = tmp;
-			if (!BADNESS(tmp))
-				break;
+		if (tmp->b_count || tmp->b_dirt || tmp->b_lock)
+			return 0;
+	} while ((tmp = tmp->b_this_page) != bh);
+	do {
+		remove_from_queues(tmp);
+		if (tmp->b_next_all)
+			tmp->b_next_all->b_prev_all = tmp->b_prev_all;
+		if (tmp->b_prev_all)
+			tmp->b_prev_all->b_next_all = tmp->b_next_all;
+		else
+			all_buffers = tmp->b_next_all;
+		tmp->b_dev = 0;
+		tmp->b_list = BUF_UNUSED;
+		tmp->b_next_free = unused_list;
+		unused_list = tmp;
+		nr_unused++;
+		NR_BUFFERS--;
+	} while ((tmp = tmp->b_this_page) != bh);
+	free_page(page);
+	io_stat.bc_shrunk++;
+	return 1;
+}
+
+static int shrink_list(int list)
+{
+	struct buffer_head * bh = lru_list[list];
+	int n;
+
+	for (n = nr_list[list] ; n-- > 0 ; bh = bh->b_next_free)
+		if (bh->b_this_page && free_buffer_page(bh))
+			return 1;
+	return 0;
+}
+
+void shrink_buffers(void)
+{
+	while (nr_free_pages < bdf_reserve &&
+	       NR_BUFFERS - PAGE_SIZE/BLOCK_SIZE >= bdf_minbuf)
+		if (!shrink_list(BUF_A1IN) && !shrink_list(BUF_AM))
+			break;
+}
+
+/*
+ * get_free_buffer() finds a buffer that can be reused: unused, clean and
+ * unlocked. It returns NULL if the one it found was taken while it slept,
+ * and the caller has to look again.
+ *
+ * Held and dirty buffers are parked as they come up at a list head (see
+ * unpark_buffer()), so each one is passed over only once, and the head
+ * of a list is what we take. If both lists run empty, the buffers are
+ * all held or dirty: we write out the dirty ones, or wait for a brelse().
+ */
+static struct buffer_head * get_free_buffer(void)
+{
+	struct buffer_head * bh;
+	int i, list;
+
+/* grow the cache if there's memory to spare and no empty buffer left */
+	if (NR_BUFFERS < bdf_maxbuf && nr_free_pages > 2*bdf_reserve &&
+	    (!lru_list[BUF_A1IN] || lru_list[BUF_A1IN]->b_dev))
+		grow_buffers();
+/* take from A1in if it's over its share, else from Am: the other one */
+/* is only looked at if there is nothing usable in the first */
+	list = (nr_list[BUF_A1IN] > KIN || !nr_list[BUF_AM]) ? BUF_A1IN : BUF_AM;
+	for (i = 0 ; i < 2 ; i++, list ^= 1)
+		while ((bh = lru_list[list])) {
+            // 引用计数为0且未被修改的缓冲块就可以用（若被锁定，下面会等待它
+            // 解锁）。否则把它从链表中取下(park)，它在被释放并且变干净时由
+            // unpark_buffer()放回链表尾部。这样每个块只会被跳过一次。
+			if (!bh->b_count && !bh->b_dirt)
+				goto found;
+			remove_from_list(bh);
+			bh->b_parked = 1;
 		}
-/* and repeat until we find something good */
-	} while ((tmp = tmp->b_next_free) != free_list);
-    // 如果循环检查发现所有缓冲块都正在被使用(所有缓冲块的头部引用计数都>0)中，
-    // 则睡眠等待有空闲缓冲块可用。当有空闲缓冲块可用时本进程会呗明确的唤醒。
-    // 然后我们跳转到函数开始处重新查找空闲缓冲块。
-	if (!bh) {
+    // 两个链表都空了，说明所有缓冲块都正在被使用或已被修改。若有已修改的块，
+    // 就把它们写盘，写完后它们会被放回链表。否则睡眠等待有空闲缓冲块可用。
+	if (nr_buffers_dirty) {
+		io_stat.bd_syncwrites++;
+		if (bdflush_wait)
+			wake_up(&bdflush_wait);
+		write_dirty(0);
+	} else
 		sleep_on(&buffer_wait);
-		goto repeat;
-	}
+	return NULL;
+found:
     // 执行到这里，说明我们已经找到了一个比较合适的空闲缓冲块了。于是先等待该缓冲区
     // 解锁。如果在我们睡眠阶段该缓冲区又被其他任务使用的话，只好重复上述寻找过程。
 	wait_on_buffer(bh);
-	if (bh->b_count)
-		goto repeat;
+	if (bh->b_count || bh->b_list == BUF_UNUSED)
+		return NULL;
     // 如果该缓冲区已被修改，则将数据写盘，并再次等待缓冲区解锁。同样地，若该缓冲区
     // 又被其他任务使用的话，只好再重复上述寻找过程。
 	while (bh->b_dirt) {
+		io_stat.bd_syncwrites++;
+		if (bdflush_wait)
+			wake_up(&bdflush_wait);
 		sync_dev(bh->b_dev);
 		wait_on_buffer(bh);
-		if (bh->b_count)
-			goto repeat;
+		if (bh->b_count || bh->b_list == BUF_UNUSED)
+			return NULL;
 	}
+	return bh;
+}
+
+//// 取高速缓冲中指定的缓冲块
+// 检查指定（设备号和块号）的缓冲区是否已经在高速缓冲中。如果指定块已经在
+// 高速缓冲中，则返回对应缓冲区头指针退出；如果不在，就需要在高速缓冲中设置一个
+// 对应设备号和块好的新项。返回相应的缓冲区头指针。
+struct buffer_head * getblk(int dev,int block)
+{
+	struct buffer_head * bh;
+
+repeat:
+    // 搜索hash表，如果指定块已经在高速缓冲中，则返回对应缓冲区头指针，退出。
+	if ((bh = get_hash_table(dev,block))) {
+		io_stat.bc_hits++;
+		return bh;
+	}
+	if (!(bh = get_free_buffer()))
+		goto repeat;
 /* NOTE!! While we slept waiting for this block, somebody else might */
 /* already have added "this" block to the cache. check it */
     // 在高速缓冲hash表中检查指定设备和块的缓冲块是否乘我们睡眠之际已经被加入
@@ -346,6 +859,12 @@ repeat:
 /* OK, FINALLY we know that this buffer is the only one of it's kind, */
 /* and that it's unused (b_count=0), unlocked (b_lock=0), and clean */
     // 于是让我们占用此缓冲块。置引用计数为1，复位修改标志和有效(更新)标志。
+	io_stat.bc_misses++;
+	if (bh->b_dev) {
+		io_stat.bc_evictions++;
+		if (bh->b_list == BUF_A1IN)
+			ghost_add(bh->b_dev,bh->b_blocknr);
+	}
 	bh->b_count=1;
 	bh->b_dirt=0;
 	bh->b_uptodate=0;
@@ -355,7 +874,41 @@ repeat:
 	remove_from_queues(bh);
 	bh->b_dev=dev;
 	bh->b_blocknr=block;
+	bh->b_list = BUF_A1IN;
+	if (ghost_find(dev,block)) {
+		io_stat.bc_ghosthits++;
+		bh->b_list = BUF_AM;
+	}
+	insert_into_queues(bh);
+	return bh;
+}
+
+/*
+ * get_delay_buffer() gives a zeroed buffer that belongs to no block, for
+ * data that has no place on disk yet (see delayed_block() in inode.c).
+ * It's held (b_count=1) and clean, so nothing else touches it until it
+ * is given back with brelse().
+ */
+struct buffer_head * get_delay_buffer(void)
+{
+	struct buffer_head * bh;
+
+	while (!(bh = get_free_buffer()))
+		/* nothing */ ;
+	if (bh->b_dev) {
+		io_stat.bc_evictions++;
+		if (bh->b_list == BUF_A1IN)
+			ghost_add(bh->b_dev,bh->b_blocknr);
+	}
+	bh->b_count=1;
+	bh->b_dirt=0;
+	bh->b_uptodate=1;
+	remove_from_queues(bh);
+	bh->b_dev=0;
+	bh->b_blocknr=0;
+	bh->b_list = BUF_A1IN;
 	insert_into_queues(bh);
+	memset(bh->b_data,0,BLOCK_SIZE);
 	return bh;
 }
 
@@ -368,9 +921,22 @@ void brelse(struct buffer_head * buf)
 	wait_on_buffer(buf);
 	if (!(buf->b_count--))
 		panic("Trying to free free buffer");
+	unpark_buffer(buf);
 	wake_up(&buffer_wait);
 }
 
+/*
+ * put_buffer() drops a reference like brelse(), but doesn't wait for
+ * the buffer to be unlocked: it is for those who only started i/o on
+ * it and don't want to wait for that.
+ */
+void put_buffer(struct buffer_head * bh)
+{
+	if (!(bh->b_count--))
+		panic("Trying to free free buffer");
+	unpark_buffer(bh);
+}
+
 /*
  * bread() reads a specified block and returns the buffer that contains
  * it. It returns NULL if the block was unreadable.
@@ -431,12 +997,9 @@ void bread_page(unsigned long address,int dev,int b[4])
     // 设备请求从设备上读取相应数据块。对于b[i]无效的块号则不用去理他了。因此
     // 本函数其实可以根据指定的b[]中的块号随意读取1-4个数据块。
 	for (i=0 ; i<4 ; i++)
-		if (b[i]) {
-			if ((bh[i] = getblk(dev,b[i])))
-				if (!bh[i]->b_uptodate)
-					ll_rw_block(READ,bh[i]);
-		} else
-			bh[i] = NULL;
+		bh[i] = b[i] ? getblk(dev,b[i]) : NULL;
+    // 块号相邻的缓冲块合成一个读请求，通常一页的4块只需一条读命令。
+	ll_rw_blocks(READ,4,bh);
     // 随后将4个缓冲块上的内容顺序复制到指定地址处。在进行复制（使用）缓冲块之前
     // 我们先要睡眠等待缓冲块解锁，另外，因为可能睡眠过了，所以我们还需要在复制
     // 之前再检查一下缓冲块中的数据是否是有效的。复制完后我们还需要释放缓冲块。
@@ -474,11 +1037,10 @@ struct buffer_head * breada(int dev,int first, ...)
 		tmp=getblk(dev,first);
 		if (tmp) {
 			if (!tmp->b_uptodate)
-                // 这句中的bh应该是tmp。
-				ll_rw_block(READA,bh);
+				ll_rw_block(READA,tmp);
             // 因为这里是预读随后的数据块，只需读进高速缓冲区但并不是马上就使用，
             // 所以这句需要将其引用计数递减释放该块(因为getblk()函数会增加引用计数值)
-			tmp->b_count--;
+			put_buffer(tmp);
 		}
 	}
     // 此时可变参数表中所有参数处理完毕。于是等待第一个缓冲区解锁，在等待退出之后，如果
@@ -491,6 +1053,112 @@ struct buffer_head * breada(int dev,int first, ...)
 	return (NULL);
 }
 
+/*
+ * bread_cluster() reads the nr blocks from 'block' on, that follow each
+ * other on disk, with one request (see ll_rw_blocks()). It returns the
+ * first one like bread() as soon as that is read: the others go into
+ * the cache, but aren't held, and may still be on their way when we
+ * return. At most NR_CLUSTER blocks are read.
+ */
+#define NR_CLUSTER 16
+
+struct buffer_head * bread_cluster(int dev,int block,int nr)
+{
+	struct buffer_head * bh[NR_CLUSTER];
+	int i;
+
+	if (nr > NR_CLUSTER)
+		nr = NR_CLUSTER;
+	for (i=0 ; i<nr ; i++)
+		if (!(bh[i]=getblk(dev,block+i)))
+			panic("bread_cluster: getblk returned NULL\n");
+	ll_rw_blocks(READ,nr,bh);
+	for (i=1 ; i<nr ; i++)
+		put_buffer(bh[i]);
+	wait_on_buffer(bh[0]);
+	if (bh[0]->b_uptodate)
+		return bh[0];
+	brelse(bh[0]);
+	return NULL;
+}
+
+/*
+ * direct_io() moves nr blocks, from 'block' on, straight between the
+ * disk and the user buffer at 'buf' (O_DIRECT). 'buf' has to be block
+ * aligned, so that no block straddles two pages. The buffer heads are
+ * on our stack and only tell the driver where the user pages are: they
+ * never go into the cache. To stay coherent with it, a block the cache
+ * has is taken from there when reading. When writing, a cached copy
+ * loses its dirty flag before our write is queued (and any write of it
+ * already under way is waited for), so that it can't be written after
+ * ours. Afterwards it is brought up to date, or thrown out if our write
+ * failed. Returns the nr of bytes done, short if there was an I/O error.
+ */
+#define NR_DIRECT 8
+
+int direct_io(int rw, int dev, int block, int nr, char * buf)
+{
+	struct buffer_head bh[NR_DIRECT], * list[NR_DIRECT], * tmp;
+	int i, n, bad, done = 0;
+
+	while (nr > 0) {
+		n = (nr < NR_DIRECT) ? nr : NR_DIRECT;
+		bad = n;
+		for (i=0 ; i<n ; i++) {
+			list[i] = NULL;
+			if (rw == READ && (tmp = get_hash_table(dev,block+i))) {
+				if (tmp->b_uptodate) {
+					copy_to_user(buf+i*BLOCK_SIZE,tmp->b_data,BLOCK_SIZE);
+					brelse(tmp);
+					continue;
+				}
+				brelse(tmp);
+			}
+			if (rw == WRITE && (tmp = get_hash_table(dev,block+i))) {
+				clear_buffer_dirty(tmp);
+				brelse(tmp);
+			}
+			if (!(bh[i].b_data = (char *)
+			    user_page((unsigned long) buf+i*BLOCK_SIZE,rw == READ))) {
+				if (i < bad)
+					bad = i;
+				continue;
+			}
+			bh[i].b_dev = dev;
+			bh[i].b_blocknr = block+i;
+			bh[i].b_uptodate = 0;
+			bh[i].b_dirt = 0;
+			bh[i].b_count = 1;
+			bh[i].b_lock = 1;
+			bh[i].b_wait = NULL;
+			bh[i].b_reqnext = NULL;
+			list[i] = bh+i;
+		}
+		ll_rw_direct(rw,n,list);
+		for (i=0 ; i<n ; i++) {
+			if (!list[i])
+				continue;
+			io_stat.direct_blocks++;
+			wait_on_buffer(list[i]);
+			if (!list[i]->b_uptodate && i < bad)
+				bad = i;
+			if (rw == WRITE && (tmp = get_hash_table(dev,block+i))) {
+				if ((tmp->b_uptodate = list[i]->b_uptodate))
+					copy_from_user(tmp->b_data,buf+i*BLOCK_SIZE,
+						BLOCK_SIZE);
+				brelse(tmp);
+			}
+		}
+		done += bad*BLOCK_SIZE;
+		if (bad < n)
+			break;
+		buf += n*BLOCK_SIZE;
+		block += n;
+		nr -= n;
+	}
+	return done;
+}
+
 // 缓冲区初始化函数
 // 参数buffer_end是缓冲区内存末端。对于具有16MB内存的系统，缓冲区末端被设置为4MB.
 // 对于有8MB内存的系统，缓冲区末端被设置为2MB。该函数从缓冲区开始位置start_buffer
@@ -524,19 +1192,115 @@ void buffer_init(long buffer_end)
 		h->b_wait = NULL;                   // 指向等待该缓冲块解锁的进程
 		h->b_next = NULL;                   // 指向具有相同hash值的下一个缓冲头
 		h->b_prev = NULL;                   // 指向具有相同hash值的前一个缓冲头
+		h->b_reqnext = NULL;                // 指向同一请求项中的下一个缓冲头
+		h->b_delay = 0;                     // 不是延迟分配的数据块
+		h->b_next_delay = NULL;
+		h->b_next_dev = h->b_prev_dev = NULL;   // 同一设备的缓冲块链表
+		h->b_next_dirty = h->b_prev_dirty = NULL;   // 同一设备的脏缓冲块链表
 		h->b_data = (char *) b;             // 指向对应缓冲块数据块（1024字节）
-		h->b_prev_free = h-1;               // 指向链表中前一项
-		h->b_next_free = h+1;               // 指向连表中后一项
+		h->b_list = BUF_A1IN;               // 新缓冲块都放在A1in队列中
+		h->b_parked = 0;
+		put_last_on_list(h);
+		h->b_this_page = NULL;              // 不属于动态分配的页面
+		h->b_prev_all = NULL;
+		if ((h->b_next_all = all_buffers))
+			all_buffers->b_prev_all = h;
+		all_buffers = h;
 		h++;                                // h指向下一新缓冲头位置
 		NR_BUFFERS++;                       // 缓冲区块数累加
 		if (b == (void *) 0x100000)         // 若b递减到等于1MB，则跳过384KB
 			b = (void *) 0xA0000;           // 让b指向地址0xA0000(640KB)处
 	}
-	h--;                                    // 让h指向最后一个有效缓冲块头
-	free_list = start_buffer;               // 让空闲链表头指向头一个缓冲快
-	free_list->b_prev_free = h;             // 链表头的b_prev_free指向前一项(即最后一项)。
-	h->b_next_free = free_list;             // h的下一项指针指向第一项，形成一个环链
-    // 最后初始化hash表，置表中所有指针为NULL。
-	for (i=0;i<NR_HASH;i++)
-		hash_table[i]=NULL;
+	for (i = MIN_HASH_BITS ; i < MAX_HASH_BITS && (1<<i) < NR_BUFFERS ; i++)
+		/* nothing */ ;
+	if (!alloc_hash(&hash_cur,i))
+		panic("No memory for buffer hash table");
+	for (i=0;i<GHOST_HASH;i++)
+		ghost_hash[i] = -1;
 }	
+
+/*
+ * flush_buffers() queues writes for old dirty buffers (or any dirty
+ * buffers, if 'all' is set), sorted on device and block so that the
+ * requests can be merged. It returns the number of buffers written.
+ */
+static int flush_buffers(int all)
+{
+	struct buffer_head * bh;
+	int i, j, k, n = 0;
+
+	for (k = 0 ; k < NR_DEVLISTS ; k++)
+	    for (bh = dev_dirty[k] ; bh && n<bdf_ndirty ; bh = bh->b_next_dirty) {
+		if (bh->b_lock)
+			continue;
+		if (!all && (long) (jiffies - bh->b_dirtime) < bdf_age)
+			continue;
+		bh->b_count++;
+		for (j = n++ ; j > 0 && BLOCK_BEFORE(bh,flush_list[j-1]) ; j--)
+			flush_list[j] = flush_list[j-1];
+		flush_list[j] = bh;
+	    }
+	for (i=0 ; i<n ; i++) {
+		ll_rw_block(WRITE,flush_list[i]);
+		put_buffer(flush_list[i]);
+	}
+	if (n)
+		wake_up(&buffer_wait);
+	io_stat.bd_written += n;
+	return n;
+}
+
+static void bdflush_alarm(void)
+{
+	bdflush_timer = 0;
+	wake_up(&bdflush_wait);
+}
+
+/*
+ * sys_bdflush(0,0) turns the caller into the flusher and never returns.
+ * func 1 does one flush pass. Func 2*n+2 reads tunable n into *data,
+ * func 2*n+3 sets it to data.
+ */
+int sys_bdflush(int func, long data)
+{
+	int i, all;
+
+	if (!suser())
+		return -EPERM;
+	if (func == 1) {
+		sync_delayed(bdf_age);
+		sync_inodes();
+		flush_buffers(0);
+		return 0;
+	}
+	if (func) {
+		i = (func-2) >> 1;
+		if (i < 0 || i >= NR_BDPARAM)
+			return -EINVAL;
+		if (!(func & 1)) {
+			verify_area((void *) data,4);
+			put_fs_long(bdf_prm[i],(unsigned long *) data);
+			return 0;
+		}
+		if (data < bdf_min[i] || data > bdf_max[i])
+			return -EINVAL;
+		bdf_prm[i] = data;
+		return 0;
+	}
+	if (bdflush_task)
+		return -EBUSY;
+	bdflush_task = current;
+	for (;;) {
+		if (!bdflush_timer) {
+			bdflush_timer = 1;
+			add_timer(bdf_interval,bdflush_alarm);
+		}
+		sleep_on(&bdflush_wait);
+		io_stat.bd_wakeups++;
+		sync_delayed(bdf_age);
+		sync_inodes();
+		do
+			all = TOO_MANY_DIRTY;
+		while (flush_buffers(all) && all);
+	}
+}
@@ -0,0 +1,208 @@
+/*
+ *  linux/fs/dcache.c
+ *
+ *  (C) 1991  Linus Torvalds
+ */
+
+/*
+ * The directory cache remembers what a name in a directory resolved to,
+ * so that path walks don't have to read through the directory blocks
+ * every time. Entries are keyed on (dev, directory inode, name) and give
+ * the inode number, or 0 for a name that wasn't there (a negative entry).
+ *
+ * Nothing here knows when a directory changes: namei.c has to call
+ * dcache_invalidate() whenever it adds or removes a name, and
+ * dcache_invalidate_dir() when a directory goes away. Only names of up
+ * to DCACHE_NAME_LEN are cached, and never "." or "..".
+ *
+ * Reading the directory can sleep, and the name may be added or removed
+ * meanwhile. So every invalidation bumps dcache_seq, and a caller that
+ * looked a name up the hard way only adds it if dcache_seq is unchanged.
+ */
+
+#include <string.h>
+
+#include <linux/sched.h>
+#include <linux/kernel.h>
+#include <sys/iostat.h>
+
+extern struct iostat io_stat;
+
+#define NR_DCACHE 128
+#define DCACHE_BITS 6
+#define DCACHE_NAME_LEN NAME_LEN
+
+struct dir_cache_entry {
+	unsigned short dev;
+	unsigned short dir;
+	unsigned short ino;		/* 0 - negative entry */
+	unsigned char len;		/* 0 - unused */
+	char name[DCACHE_NAME_LEN];
+	struct dir_cache_entry * next;	/* hash chain */
+	struct dir_cache_entry * prev;
+	struct dir_cache_entry * next_lru;
+	struct dir_cache_entry * prev_lru;
+};
+
+static struct dir_cache_entry dcache[NR_DCACHE];
+static struct dir_cache_entry * dcache_hash[1 << DCACHE_BITS];
+static struct dir_cache_entry * lru_head = NULL;
+unsigned long dcache_seq = 0;
+
+static unsigned long name_hash(int dev, int dir, const char * name, int len)
+{
+	unsigned long h = (dev << 16) ^ dir;
+
+	while (len--)
+		h = (h << 4) + (h >> 28) + *(unsigned char *) name++;
+	return (h * 0x9E370001UL) >> (32 - DCACHE_BITS);
+}
+
+static inline void remove_from_hash(struct dir_cache_entry * de)
+{
+	if (!de->len)
+		return;
+	if (de->next)
+		de->next->prev = de->prev;
+	if (de->prev)
+		de->prev->next = de->next;
+	else if (dcache_hash[name_hash(de->dev,de->dir,de->name,de->len)] == de)
+		dcache_hash[name_hash(de->dev,de->dir,de->name,de->len)] = de->next;
+	de->next = de->prev = NULL;
+}
+
+/*
+ * The lru list is circular, lru_head being the least recently used
+ * entry. Unused entries are moved to the head, so they get picked first.
+ */
+static inline void put_last_lru(struct dir_cache_entry * de)
+{
+	if (de == lru_head) {
+		lru_head = de->next_lru;
+		return;
+	}
+	de->prev_lru->next_lru = de->next_lru;
+	de->next_lru->prev_lru = de->prev_lru;
+	de->next_lru = lru_head;
+	de->prev_lru = lru_head->prev_lru;
+	lru_head->prev_lru->next_lru = de;
+	lru_head->prev_lru = de;
+}
+
+static inline void put_first_lru(struct dir_cache_entry * de)
+{
+	put_last_lru(de);
+	lru_head = de;
+}
+
+static void release_entry(struct dir_cache_entry * de)
+{
+	remove_from_hash(de);
+	de->len = 0;
+	put_first_lru(de);
+}
+
+static struct dir_cache_entry * find_dcache(int dev, int dir,
+	const char * name, int len)
+{
+	struct dir_cache_entry * de;
+
+	for (de = dcache_hash[name_hash(dev,dir,name,len)] ; de ; de = de->next)
+		if (de->dev == dev && de->dir == dir && de->len == len &&
+		    !memcmp(de->name,name,len))
+			return de;
+	return NULL;
+}
+
+/*
+ * dcache_lookup() returns 1 and sets *ino if the name is in the cache
+ * (*ino is 0 for a negative entry), and 0 if it has to be looked up.
+ * The name is in kernel space.
+ */
+int dcache_lookup(int dev, int dir, const char * name, int len, int * ino)
+{
+	struct dir_cache_entry * de;
+
+	if (len > DCACHE_NAME_LEN)
+		return 0;
+	if (!(de = find_dcache(dev,dir,name,len))) {
+		io_stat.dc_misses++;
+		return 0;
+	}
+	io_stat.dc_hits++;
+	put_last_lru(de);
+	*ino = de->ino;
+	return 1;
+}
+
+void dcache_add(int dev, int dir, const char * name, int len, int ino)
+{
+	struct dir_cache_entry * de;
+
+	if (!len || len > DCACHE_NAME_LEN)
+		return;
+	if (!(de = find_dcache(dev,dir,name,len))) {
+		de = lru_head;
+		remove_from_hash(de);
+		de->dev = dev;
+		de->dir = dir;
+		de->len = len;
+		memcpy(de->name,name,len);
+		de->next = dcache_hash[name_hash(dev,dir,name,len)];
+		if (de->next)
+			de->next->prev = de;
+		dcache_hash[name_hash(dev,dir,name,len)] = de;
+	}
+	de->ino = ino;
+	put_last_lru(de);
+}
+
+void dcache_invalidate(int dev, int dir, const char * name, int len)
+{
+	struct dir_cache_entry * de;
+
+	dcache_seq++;
+	if (len > DCACHE_NAME_LEN)
+		return;
+	if ((de = find_dcache(dev,dir,name,len)))
+		release_entry(de);
+}
+
+/*
+ * A removed directory's inode number can be reused for a new one, so
+ * everything cached under it has to go.
+ */
+void dcache_invalidate_dir(int dev, int dir)
+{
+	int i;
+
+	dcache_seq++;
+	for (i=0 ; i<NR_DCACHE ; i++)
+		if (dcache[i].len && dcache[i].dev == dev && dcache[i].dir == dir)
+			release_entry(dcache+i);
+}
+
+void dcache_invalidate_dev(int dev)
+{
+	int i;
+
+	dcache_seq++;
+	for (i=0 ; i<NR_DCACHE ; i++)
+		if (dcache[i].len && dcache[i].dev == dev)
+			release_entry(dcache+i);
+}
+
+void dcache_init(void)
+{
+	int i;
+
+	for (i=0 ; i<NR_DCACHE ; i++) {
+		dcache[i].len = 0;
+		dcache[i].next = dcache[i].prev = NULL;
+		dcache[i].next_lru = dcache+(i+1)%NR_DCACHE;
+		dcache[i].prev_lru = dcache+(i+NR_DCACHE-1)%NR_DCACHE;
+	}
+	for (i=0 ; i < (1 << DCACHE_BITS) ; i++)
+		dcache_hash[i] = NULL;
+	lru_head = dcache;
+}
@@ -130,7 +130,7 @@ static unsigned long copy_strings(int argc,char ** argv,unsigned long *page,
 		unsigned long p, int from_kmem)
 {
 	char *tmp, *pag=NULL;
-	int len, offset = 0;
+	int len, chars, offset = 0;
 	unsigned long old_fs, new_fs;
 
     // 首先取当前段寄存器ds（指向内核数据段）和fs值，分别保存到变量new_fs和
@@ -165,26 +165,25 @@ static unsigned long copy_strings(int argc,char ** argv,unsigned long *page,
 			set_fs(old_fs);
 			return 0;
 		}
-        // 接着我们逆向逐个字符地把字符串复制到参数和环境空间末端处。在循环复制
-        // 字符串的字符过程中，我们首先要判断参数和环境空间相应位置是否已经有内
-        // 存页面。如果还没有就先为其申请1页内存页面。偏移量offset被用作为在一
-        // 个页面中的当前指针偏移量。因为刚开始执行本函数时，偏移量offset被初始
-        // 化为0，所以(offset-1<0)肯定成立而使得offset重新被设置为当前p指针在页
-        // 面返回内的偏移值。
+        // 接着我们逆向地把字符串复制到参数和环境空间末端处，每次复制落在同一页
+        // 面中的一段。在循环复制过程中，我们首先要判断参数和环境空间相应位置是
+        // 否已经有内存页面。如果还没有就先为其申请1页内存页面。偏移量offset是p
+        // 指针在当前页面中的偏移值，即页面中p以下还可存放的字节数。因为刚开始
+        // 执行本函数时，偏移量offset被初始化为0，所以(offset<=0)肯定成立而使得
+        // offset重新被设置为p-1所在页面中p的偏移值。
 		while (len) {
-			--p; --tmp; --len;
-			if (--offset < 0) {
-				offset = p % PAGE_SIZE;
+			if (offset <= 0) {
+				offset = (p-1) % PAGE_SIZE + 1;
                 // 如果字符串和字符串数组都在内核空间中，那么为了从内核数据空间
                 // 复制字符串内容，下面会把fs设置为指向内核数据段。
 				if (from_kmem==2)
 					set_fs(old_fs);
-                // 如果当前偏移量p所在的串空间页面指针数组项page[p/PAGE_SIZE]==
+                // 如果p-1所在的串空间页面指针数组项page[(p-1)/PAGE_SIZE]==
                 // 0,表示此时p指针所处的空间内存页面还不存在，则需申请一空闲内
                 // 存页，并将该页面指针填入指针数组，同时也使页面指针pag 指向该
                 // 新页面，若申请不到空闲页面则返回0.
-				if (!(pag = (char *) page[p/PAGE_SIZE]) &&
-				    !(pag = (char *) page[p/PAGE_SIZE] =
+				if (!(pag = (char *) page[(p-1)/PAGE_SIZE]) &&
+				    !(pag = (char *) page[(p-1)/PAGE_SIZE] =
 				      (unsigned long *) get_free_page())) 
 					return 0;
                 // 如果字符串在内核空间，则设置fs段寄存器指向内核数据段(ds)。
@@ -192,8 +191,11 @@ static unsigned long copy_strings(int argc,char ** argv,unsigned long *page,
 					set_fs(new_fs);
 
 			}
-            // 然后从fs段中复制字符串的1字节到参数和环境空间内存页面pag的offset出。
-			*(pag + offset) = get_fs_byte(tmp);
+            // 然后从fs段中把字符串落在本页面中的部分一次复制到参数和环境空间内存
+            // 页面pag的offset处。
+			chars = (len < offset) ? len : offset;
+			p -= chars; tmp -= chars; len -= chars; offset -= chars;
+			copy_from_user(pag + offset,tmp,chars);
 		}
 	}
     // 如果字符串和字符串数组在内核空间，则恢复fs段寄存器原值。最后，返回参数和
@@ -339,7 +341,9 @@ restart_interp:
     // 我们需要跳转去执行，因此在下面确认处并处理了脚本文件之后需要设置一个禁止
     // 再次执行下面的脚本处理代码标志sh_bang。在后面的代码中该标志也用来表示我
     // 们已经设置好执行的命令行参数，不用重复设置。
-	if (!(bh = bread(inode->i_dev,inode->i_zone[0]))) {
+	update_atime(inode,0);
+	if (commit_delayed(inode) ||	/* the zones are read directly */
+	    !(bh = bread(inode->i_dev,inode->i_zone[0]))) {
 		retval = -EACCES;
 		goto exec_error2;
 	}
@@ -552,8 +556,8 @@ restart_interp:
     // 如果执行文件代码加数据长度的末端不再页面边界上，则把最后不到1页长度的内
     // 存过空间初始化为零。
 	i = ex.a_text+ex.a_data;
-	while (i&0xfff)
-		put_fs_byte(0,(char *) (i++));
+	if (i&0xfff)
+		clear_user((char *) i,4096-(i&0xfff));
     // 最后将原调用系统中断的程序在堆栈上的代码指针替换为指向新执行程序的入口点，
     // 并将栈指针替换为执行文件的栈指针。此后返回指令将这些栈数据并使得CPU去执
     // 行新执行文件，因此不会返回到原调用系统中断的程序中去了。
@@ -94,8 +94,8 @@ int sys_fcntl(unsigned int fd, unsigned int cmd, unsigned long arg)
 		case F_GETFL:
 			return filp->f_flags;
 		case F_SETFL:
-			filp->f_flags &= ~(O_APPEND | O_NONBLOCK);
-			filp->f_flags |= arg & (O_APPEND | O_NONBLOCK);
+			filp->f_flags &= ~(O_APPEND | O_NONBLOCK | O_DIRECT);
+			filp->f_flags |= arg & (O_APPEND | O_NONBLOCK | O_DIRECT);
 			return 0;
 		case F_GETLK:	case F_SETLK:	case F_SETLKW:
 			return -1;
@@ -14,12 +14,125 @@
 #define MIN(a,b) (((a)<(b))?(a):(b))
 #define MAX(a,b) (((a)>(b))?(a):(b))
 
+/*
+ * Readahead: a read that starts where the last one ended is sequential,
+ * and doubles the readahead window of the file (up to MAX_READAHEAD
+ * blocks), anything else closes it. The blocks of the read itself and
+ * of the window behind it are queued with READA before we wait for the
+ * first one, so they go out as a few large requests, and a streaming
+ * reader finds the next blocks already in the cache.
+ *
+ * Never more than MAX_READAHEAD blocks are queued ahead of the block
+ * being read: file_read() moves the queue on when it has used up half
+ * of that. Otherwise a big read would queue all of its blocks at once,
+ * and the last ones could push the first out of the cache before they
+ * are copied.
+ */
+static void file_readahead(struct m_inode * inode, struct file * filp,
+	unsigned long block, unsigned long end)
+{
+	unsigned long size = (inode->i_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	struct buffer_head * bh;
+	int nr;
+
+	end = MIN(MIN(end + filp->f_rawin, block + MAX_READAHEAD), size);
+	for (block = MAX(block,filp->f_raend) ; block < end ; block++) {
+		if (!(nr = bmap_nodelay(inode,block)))
+			continue;
+		if (!(bh = getblk(inode->i_dev,nr)))
+			break;
+		if (!bh->b_uptodate)
+			ll_rw_block(READA,bh);
+		put_buffer(bh);		/* not brelse(): that would wait */
+	}
+	if (end > filp->f_raend)
+		filp->f_raend = end;
+}
+
+static void readahead_window(struct file * filp, unsigned long block)
+{
+	if (block == filp->f_ranext)
+		filp->f_rawin = MIN(MAX(2*filp->f_rawin,MIN_READAHEAD),
+			MAX_READAHEAD);
+	else
+		filp->f_rawin = filp->f_raend = 0;
+}
+
+/*
+ * O_DIRECT: the whole blocks of a read or write that starts block aligned,
+ * into a block aligned user buffer, go straight between the disk and the
+ * user pages (see direct_io() in buffer.c), zones that follow each other
+ * on disk in one go. The rest, like the partial block at the end of the
+ * file, goes through the cache as usual, and so does everything when the
+ * alignment isn't right.
+ */
+#define DIRECT_OK(pos,buf) \
+	(!(((unsigned long) (pos) | (unsigned long) (buf)) & (BLOCK_SIZE-1)))
+
+/*
+ * direct_zone() gives the zone of block, allocating it when writing. A
+ * zone that is new sets bit i of *fresh: if the write to it fails, it
+ * has to be cleared, or the file would get whatever was on the disk.
+ * That is why a run is at most MAX_RUN blocks, the bits of a long.
+ */
+#define MAX_RUN 32
+
+static int direct_zone(int rw, struct m_inode * inode, int block,
+	unsigned long * fresh, int i)
+{
+	if (rw == READ)
+		return bmap(inode,block);
+	if (!bmap(inode,block))
+		*fresh |= 1UL << i;
+	return create_block(inode,block);
+}
+
+static int file_direct(int rw, struct m_inode * inode, off_t pos,
+	char * buf, int count)
+{
+	int block = pos / BLOCK_SIZE;
+	int nr, n, i, chars, done = 0;
+	unsigned long fresh;
+
+	if (inode->i_delay && commit_delayed(inode))
+		return 0;		/* the disk has to be up to date */
+	while (done < count) {
+		fresh = 0;
+		nr = direct_zone(rw,inode,block,&fresh,0);
+		if (!nr) {
+			if (rw == WRITE)
+				break;
+			clear_user(buf,BLOCK_SIZE);	/* a hole */
+			chars = BLOCK_SIZE;
+			n = 1;
+		} else {
+			for (n = 1 ; n < MAX_RUN && done + n*BLOCK_SIZE < count ; n++)
+				if (nr+n != direct_zone(rw,inode,block+n,&fresh,n))
+					break;
+			chars = direct_io(rw,inode->i_dev,nr,n,buf);
+		}
+		done += chars;
+		buf += chars;
+		block += n;
+		if (chars < n*BLOCK_SIZE) {
+			for (i = chars/BLOCK_SIZE ; i < n ; i++)
+				if (fresh & (1UL << i))
+					zero_block(inode->i_dev,nr+i);
+			break;
+		}
+	}
+	return done;
+}
+
 //// 文件读函数 - 根据i节点和文件结构，读取文件中数据。
 // 由i节点我们可以知道设备号，由filp结构可以知道文件中当前读写指针位置。buf指定
-// 用户空间中缓冲区位置，count是需要读取字节数。返回值是实际读取的字节数，或出错号(小于0).
-int file_read(struct m_inode * inode, struct file * filp, char * buf, int count)
+// 用户空间中缓冲区位置，count是需要读取字节数，pos指向读取位置(通常是filp->f_pos，
+// pread()则是自己的位置)。返回值是实际读取的字节数，或出错号(小于0).
+int file_read(struct m_inode * inode, struct file * filp, char * buf, int count,
+	off_t * pos)
 {
-	int left,chars,nr;
+	int left,chars,nr,delayed,ra = 0;
+	unsigned long block, end;
 	struct buffer_head * bh;
 
     // 首先判断参数的有效性。若需要读取的字节数count小于等于0，则返回0.若还需要读
@@ -27,11 +140,32 @@ int file_read(struct m_inode * inode, struct file * filp, char * buf, int count)
     // 操作过程中，我们根据i节点和文件表结构信息，并利用bmap()得到包含文件当前读写
     // 位置的数据块在设备上对应的逻辑块号nr。若nr不为0，则从i节点指定的设备上读取该
     // 逻辑块。如果读操作是吧则退出循环。若nr为0，表示指定的数据块不存在，置缓冲块
-    // 指针为NULL。(filp->f_pos)/BLOCK_SIZE用于计算出文件当前指针所在的数据块号。
+    // 指针为NULL。(*pos)/BLOCK_SIZE用于计算出文件当前指针所在的数据块号。
 	if ((left=count)<=0)
 		return 0;
+    // O_DIRECT的整块部分不经过高速缓冲，直接读到用户缓冲区中，也不做预读。
+	if (filp->f_flags & O_DIRECT) {
+		if (DIRECT_OK(*pos,buf) && (nr = left & ~(BLOCK_SIZE-1))) {
+			chars = file_direct(READ,inode,*pos,buf,nr);
+			*pos += chars;
+			buf += chars;
+			left -= chars;
+			if (chars < nr)
+				goto out;
+		}
+	} else {
+		readahead_window(filp,*pos / BLOCK_SIZE);
+		ra = 1;
+	}
+	end = (*pos + left - 1) / BLOCK_SIZE + 1;
 	while (left) {
-		if ((nr = bmap(inode,(filp->f_pos)/BLOCK_SIZE))) {
+		block = *pos / BLOCK_SIZE;
+		if (ra && block + MAX_READAHEAD/2 >= filp->f_raend)
+			file_readahead(inode,filp,block,end);
+		delayed = 0;
+		if ((bh = delayed_block(inode,(*pos)/BLOCK_SIZE,0)))
+			delayed = 1;
+		else if ((nr = bmap(inode,(*pos)/BLOCK_SIZE))) {
 			if (!(bh=bread(inode->i_dev,nr)))
 				break;
 		} else
@@ -41,36 +175,40 @@ int file_read(struct m_inode * inode, struct file * filp, char * buf, int count)
         // 即为本次操作需读取的字节数chars。如果(BLOCK_SIZE-nr) > left，则说明该块
         // 是需要读取的最后一块数据。反之还需要读取下一块数据。之后调整读写文件指针。
         // 指针前移此次将读取的字节数chars，剩余字节计数left相应减去chars。
-		nr = filp->f_pos % BLOCK_SIZE;
+		nr = *pos % BLOCK_SIZE;
 		chars = MIN( BLOCK_SIZE-nr , left );
-		filp->f_pos += chars;
+		*pos += chars;
 		left -= chars;
         // 若上面从设备上读到了数据，则将p指向缓冲块中开始读取数据的位置，并且复制chars
         // 字节到用户缓冲区buf中。否则往用户缓冲区中填入chars个0值字节。
 		if (bh) {
-			char * p = nr + bh->b_data;
-			while (chars-->0)
-				put_fs_byte(*(p++),buf++);
-			brelse(bh);
-		} else {
-			while (chars-->0)
-				put_fs_byte(0,buf++);
-		}
+			copy_to_user(buf,nr + bh->b_data,chars);
+			if (delayed)
+				release_delayed(bh);
+			else
+				brelse(bh);
+		} else
+			clear_user(buf,chars);
+		buf += chars;
 	}
+out:
     // 修改该i节点的访问时间为当前时间。返回读取的字节数，若读取字节数为0，则返回
     // 出错号。CURRENT_TIME是定义在include/linux/sched.h中的宏，用于计算UNIX时间。
     // 即从1970年1月1日0时0分0秒开始，到当前的时间，单位是秒。
-	inode->i_atime = CURRENT_TIME;
+	filp->f_ranext = *pos / BLOCK_SIZE;
+	update_atime(inode,0);
 	return (count-left)?(count-left):-ERROR;
 }
 
 //// 文件写函数 - 根据i节点和文件结构信息，将用户数据写入文件中。
 // 由i节点我们可以知道设备号，而由file结构可以知道文件中当前读写指针位置。buf指定
-// 用户态缓冲区的位置，count为需要写入的字节数。返回值是实际写入的字节数，或出错号。
-int file_write(struct m_inode * inode, struct file * filp, char * buf, int count)
+// 用户态缓冲区的位置，count为需要写入的字节数，ppos指向写入位置(pwrite()时不是
+// filp->f_pos)。返回值是实际写入的字节数，或出错号。
+int file_write(struct m_inode * inode, struct file * filp, char * buf, int count,
+	off_t * ppos)
 {
 	off_t pos;
-	int block,c;
+	int block,c,delayed;
 	struct buffer_head * bh;
 	char * p;
 	int i=0;
@@ -84,17 +222,36 @@ int file_write(struct m_inode * inode, struct file * filp, char * buf, int count
 	if (filp->f_flags & O_APPEND)
 		pos = inode->i_size;
 	else
-		pos = filp->f_pos;
+		pos = *ppos;
+    // O_DIRECT的整块部分直接从用户缓冲区写到盘上，剩下的部分仍经过高速缓冲。
+	if ((filp->f_flags & O_DIRECT) && DIRECT_OK(pos,buf) &&
+	    (c = count & ~(BLOCK_SIZE-1))) {
+		i = file_direct(WRITE,inode,pos,buf,c);
+		pos += i;
+		buf += i;
+		if (pos > inode->i_size) {
+			inode->i_size = pos;
+			mark_inode_dirty(inode);
+		}
+		if (i < c)
+			count = i;
+	}
     // 然后在已写入字节数i(刚开始为0)小于指定写入字节数count时，循环执行以下操作。
     // 在循环操作过程中，我们先取文件数据块号(pos/BLOCK_SIZE)在设备上对应的逻辑
     // 块号block。如果对应的逻辑块不存在就创建一块。如果得到的逻辑块号=0，则表示
     // 创建失败，于是退出循环。否则我们根据该逻辑块号读取设备上的相应逻辑块，若出
-    // 错也退出循环。
+    // 错也退出循环。普通文件中还没有逻辑块的数据块则先写入延迟分配的缓冲块中，
+    // 等到回写时才为其分配逻辑块(参见inode.c中的delayed_block())。
 	while (i<count) {
-		if (!(block = create_block(inode,pos/BLOCK_SIZE)))
-			break;
-		if (!(bh=bread(inode->i_dev,block)))
-			break;
+		delayed = 0;
+		if ((bh = delayed_block(inode,pos/BLOCK_SIZE,1)))
+			delayed = 1;
+		else {
+			if (!(block = create_block(inode,pos/BLOCK_SIZE)))
+				break;
+			if (!(bh=bread(inode->i_dev,block)))
+				break;
+		}
         // 此时缓冲块指针bh正指向刚读入的文件数据库。现在再求出文件当前读写指针在该
         // 数据块中的偏移值c，并将指针p指向缓冲块中开始写入数据的位置，并置该缓冲块已
         // 修改标志。对于块中当前指针，从开始读写位置到块末共可写入c=(BLOCK_SIZE - c)
@@ -102,7 +259,8 @@ int file_write(struct m_inode * inode, struct file * filp, char * buf, int count
         // 个字节即可。
 		c = pos % BLOCK_SIZE;
 		p = c + bh->b_data;
-		bh->b_dirt = 1;
+		if (!delayed)
+			mark_buffer_dirty(bh);
 		c = BLOCK_SIZE-c;
 		if (c > count-i) c = count-i;
         // 在写入数据之前，我们先预先设置好下一次循环操作要读写文件中的位置。因此我们
@@ -113,12 +271,15 @@ int file_write(struct m_inode * inode, struct file * filp, char * buf, int count
 		pos += c;
 		if (pos > inode->i_size) {
 			inode->i_size = pos;
-			inode->i_dirt = 1;
+			mark_inode_dirty(inode);
 		}
 		i += c;
-		while (c-->0)
-			*(p++) = get_fs_byte(buf++);
-		brelse(bh);
+		copy_from_user(p,buf,c);
+		buf += c;
+		if (delayed)
+			release_delayed(bh);
+		else
+			brelse(bh);
 	}
     // 当数据已全部写入文件或者在写操作工程中发生问题时就会退出循环。此时我们更改文件修改
     // 时间为当前时间，并调整文件读写指针。如果此次操作不是在文件尾部添加数据，则把文件
@@ -126,7 +287,7 @@ int file_write(struct m_inode * inode, struct file * filp, char * buf, int count
     // 的字节数，若写入字节数为0，则返回出错号-1.
 	inode->i_mtime = CURRENT_TIME;
 	if (!(filp->f_flags & O_APPEND)) {
-		filp->f_pos = pos;
+		*ppos = pos;
 		inode->i_ctime = CURRENT_TIME;
 	}
 	return (i?i:-1);
@@ -5,20 +5,46 @@
  */
 
 #include <string.h> 
+#include <stddef.h>
+#include <errno.h>
 #include <sys/stat.h>
 
 #include <linux/sched.h>
 #include <linux/kernel.h>
 #include <linux/mm.h>
 #include <asm/system.h>
+#include <sys/iostat.h>
 
-// 内存中i节点表(NR_INODE=32)
-struct m_inode inode_table[NR_INODE]={{0,},};
+extern int nr_free_pages;
+extern struct iostat io_stat;
+
+/*
+ * The in-core inodes start out as inode_table, and more are taken a
+ * page at a time when they are needed, up to max_inodes: one per free
+ * page of memory at boot, but at most MAX_INODES. Inodes are hashed on
+ * (dev,nr), and the ones nobody holds (i_count == 0) are kept on
+ * unused_list in LRU order, so that neither iget() nor get_empty_inode()
+ * has to walk the whole table. Inodes that hold nothing (i_dev == 0) are
+ * put at the front of unused_list, so they are reused first.
+ */
+#define MAX_INODES 2048
+#define IHASH_BITS 9
+#define IHASHVAL(dev,nr) \
+((((unsigned long)(dev) << 16) ^ (unsigned long)(nr)) * 0x9E370001UL)
+#define ihash(dev,nr) (inode_hash[IHASHVAL(dev,nr) >> (32 - IHASH_BITS)])
+
+static struct m_inode inode_table[NR_INODE];
+static struct m_inode * inode_hash[1 << IHASH_BITS];
+static struct m_inode * unused_list = NULL;
+static struct m_inode * all_inodes = NULL;
+int nr_inodes = 0;
+static int max_inodes = NR_INODE;
 
 // 读指定i节点号的i节点信息
 static void read_inode(struct m_inode * inode);
 // 写i节点信息到高速缓冲中
 static void write_inode(struct m_inode * inode);
+static int _bmap(struct m_inode * inode,int block,int create);
 
 //// 等待指定的i节点可用
 // 如果i节点已被锁定，则将当前任务置为不可中断的等待状态，并添加到该
@@ -51,72 +77,339 @@ static inline void unlock_inode(struct m_inode * inode)
 	wake_up(&inode->i_wait);
 }
 
+static void remove_from_unused(struct m_inode * inode)
+{
+	if (!inode->i_next_free)
+		return;
+	if (inode->i_next_free == inode)
+		unused_list = NULL;
+	else {
+		inode->i_prev_free->i_next_free = inode->i_next_free;
+		inode->i_next_free->i_prev_free = inode->i_prev_free;
+		if (unused_list == inode)
+			unused_list = inode->i_next_free;
+	}
+	inode->i_next_free = inode->i_prev_free = NULL;
+}
+
+static void put_last_unused(struct m_inode * inode)
+{
+	remove_from_unused(inode);
+	if (!unused_list) {
+		unused_list = inode->i_next_free = inode->i_prev_free = inode;
+		return;
+	}
+	inode->i_next_free = unused_list;
+	inode->i_prev_free = unused_list->i_prev_free;
+	unused_list->i_prev_free->i_next_free = inode;
+	unused_list->i_prev_free = inode;
+}
+
+static inline void put_first_unused(struct m_inode * inode)
+{
+	put_last_unused(inode);
+	unused_list = inode;
+}
+
+/*
+ * An inode is on the hash chains iff it has a device: anybody who
+ * changes i_dev or i_num has to unhash it first.
+ */
+static void unhash_inode(struct m_inode * inode)
+{
+	if (inode->i_next)
+		inode->i_next->i_prev = inode->i_prev;
+	if (inode->i_prev)
+		inode->i_prev->i_next = inode->i_next;
+	else if (inode->i_dev && ihash(inode->i_dev,inode->i_num) == inode)
+		ihash(inode->i_dev,inode->i_num) = inode->i_next;
+	inode->i_next = inode->i_prev = NULL;
+}
+
+void insert_inode_hash(struct m_inode * inode)
+{
+	inode->i_prev = NULL;
+	if ((inode->i_next = ihash(inode->i_dev,inode->i_num)))
+		inode->i_next->i_prev = inode;
+	ihash(inode->i_dev,inode->i_num) = inode;
+}
+
+static struct m_inode * find_inode(int dev, int nr)
+{
+	struct m_inode * inode;
+
+	for (inode = ihash(dev,nr) ; inode ; inode = inode->i_next)
+		if (inode->i_dev == dev && inode->i_num == nr)
+			return inode;
+	return NULL;
+}
+
+/*
+ * The dirty inodes are kept on dirty_inodes, so that sync_inodes()
+ * doesn't have to look at all of them. An inode is on it iff i_dirt is
+ * set: set it with mark_inode_dirty(), and clear it with clear_dirty().
+ */
+static struct m_inode * dirty_inodes = NULL;
+static int nr_dirty_inodes = 0;
+
+void mark_inode_dirty(struct m_inode * inode)
+{
+	if (inode->i_dirt)
+		return;
+	inode->i_dirt = 1;
+	inode->i_prev_dirty = NULL;
+	if ((inode->i_next_dirty = dirty_inodes))
+		dirty_inodes->i_prev_dirty = inode;
+	dirty_inodes = inode;
+	nr_dirty_inodes++;
+}
+
+static void clear_dirty(struct m_inode * inode)
+{
+	if (!inode->i_dirt)
+		return;
+	if (inode->i_next_dirty)
+		inode->i_next_dirty->i_prev_dirty = inode->i_prev_dirty;
+	if (inode->i_prev_dirty)
+		inode->i_prev_dirty->i_next_dirty = inode->i_next_dirty;
+	else
+		dirty_inodes = inode->i_next_dirty;
+	inode->i_next_dirty = inode->i_prev_dirty = NULL;
+	inode->i_dirt = 0;
+	nr_dirty_inodes--;
+}
+
+/*
+ * clear_inode() empties an inode: it is unhashed and goes to the front
+ * of the unused list. The list pointers are all that is left.
+ */
+void clear_inode(struct m_inode * inode)
+{
+	clear_dirty(inode);
+	unhash_inode(inode);
+	memset(inode,0,offsetof(struct m_inode,i_next));
+	put_first_unused(inode);
+}
+
+static void add_inode(struct m_inode * inode)
+{
+	inode->i_next_all = all_inodes;
+	all_inodes = inode;
+	nr_inodes++;
+	put_first_unused(inode);
+}
+
+static void grow_inodes(void)
+{
+	struct m_inode * inode;
+	unsigned long page;
+	int i;
+
+	if (!(page = get_free_page()))
+		return;
+	inode = (struct m_inode *) page;
+	for (i = PAGE_SIZE/sizeof(struct m_inode) ; i ; i--,inode++)
+		add_inode(inode);
+}
+
+void inode_init(void)
+{
+	int i;
+
+	max_inodes = nr_free_pages;
+	if (max_inodes > MAX_INODES)
+		max_inodes = MAX_INODES;
+	for (i=0 ; i<NR_INODE ; i++)
+		add_inode(inode_table+i);
+}
+
+/*
+ * fs_may_umount() tells if no inode of dev is in use.
+ */
+int fs_may_umount(int dev)
+{
+	struct m_inode * inode;
+
+	for (inode = all_inodes ; inode ; inode = inode->i_next_all)
+		if (inode->i_dev==dev && inode->i_count)
+			return 0;
+	return 1;
+}
+
 //// 释放设备dev在内存i节点表中的所有i节点
 // 扫描内存中的i节点表数组，如果是指定设备使用的i节点就释放之。
 void invalidate_inodes(int dev)
 {
-	int i;
 	struct m_inode * inode;
 
     // 首先让指针指向内存i节点表数组首项。然后扫描i节点表指针数组中的所有i
     // 节点。针对其中每个i节点，先等待该i节点解锁可用，再判断是否属于指定设备
     // 的i节点。如果是指定设备的i节点，则看看它是否还被使用着，即其引用计数
     // 是否不为0.若是则显示警告信息。然后释放之，即把i节点的设备号字段i_dev置0.
-	inode = 0+inode_table;                      // 指向i节点表指针数组首项
-	for(i=0 ; i<NR_INODE ; i++,inode++) {
+	for (inode = all_inodes ; inode ; inode = inode->i_next_all) {
 		wait_on_inode(inode);
 		if (inode->i_dev == dev) {
 			if (inode->i_count)
 				printk("inode in use on removed disk\n\r");
-			inode->i_dev = inode->i_dirt = 0;
+			discard_delayed(inode);
+			unhash_inode(inode);
+			clear_dirty(inode);
+			inode->i_dev = 0;
+			inode->i_pcount = inode->i_ext_len = 0;
+			if (!inode->i_count)
+				put_first_unused(inode);
 		}
 	}
 }
 
-//// 同步所有i节点
-// 把内存i节点表中所有i节点与设备上i节点作同步操作
-void sync_inodes(void)
+/*
+ * sync_inodes() writes the dirty inodes into their buffers, up to
+ * INODE_BATCH at a time. A batch is sorted on device and inode block,
+ * so that each inode block is read and dirtied once for all the inodes
+ * in it, and in the order they are on disk. Inodes dirtied while we
+ * sleep are left for the next time.
+ */
+#define INODE_BATCH 64
+#define INODE_BLOCK(inode) (((inode)->i_num-1)/INODES_PER_BLOCK)
+#define INODE_BEFORE(a,b) ((a)->i_dev < (b)->i_dev || \
+((a)->i_dev == (b)->i_dev && INODE_BLOCK(a) < INODE_BLOCK(b)))
+
+static void write_inodes(int dev, int nr, struct m_inode ** list, int n)
 {
-	int i;
+	struct super_block * sb;
+	struct buffer_head * bh;
 	struct m_inode * inode;
 
-    // 首先让内存i节点类型的指针指向i节点表首项，然后扫描整个i节点表中的节点。针对
-    // 其中每个i节点，先等待该i节点解锁可用(若目前正被上锁的话)，然后判断该i节点
-    // 是否已被修改并且不是管道节点。若是这种情况则将该i节点写入高速缓冲区中。
-    // 缓冲区管理程序buffer.c会在适当时机将他们写入盘中。
-	inode = 0+inode_table;
-	for(i=0 ; i<NR_INODE ; i++,inode++) {
+	if (!(sb=get_super(dev)))
+		panic("trying to write inode without device");
+	if (!(bh=bread(dev,2 + sb->s_imap_blocks + sb->s_zmap_blocks + nr)))
+		panic("unable to read i-node block");
+	while (n--) {
+		inode = *list++;
 		wait_on_inode(inode);
-		if (inode->i_dirt && !inode->i_pipe)
-			write_inode(inode);
+		if (!inode->i_dirt || inode->i_dev != dev ||
+		    INODE_BLOCK(inode) != nr)
+			continue;
+		((struct d_inode *)bh->b_data)
+			[(inode->i_num-1)%INODES_PER_BLOCK] =
+				*(struct d_inode *)inode;
+		clear_dirty(inode);
+	}
+	mark_buffer_dirty(bh);
+	brelse(bh);
+}
+
+void sync_inodes(void)
+{
+	struct m_inode * inode, * list[INODE_BATCH];
+	int i, j, n, left = nr_dirty_inodes;
+
+	while (left > 0 && dirty_inodes) {
+		n = 0;
+		for (inode = dirty_inodes ; inode && n < INODE_BATCH ;
+		     inode = inode->i_next_dirty) {
+			for (j = n++ ; j > 0 && INODE_BEFORE(inode,list[j-1]) ; j--)
+				list[j] = list[j-1];
+			list[j] = inode;
+		}
+		left -= n;
+		for (i = 0 ; i < n ; i = j) {
+			inode = list[i];
+			if (inode->i_pipe || !inode->i_dev) {
+				clear_dirty(inode);
+				j = i+1;
+				continue;
+			}
+			for (j = i+1 ; j < n ; j++)
+				if (list[j]->i_dev != inode->i_dev ||
+				    INODE_BLOCK(list[j]) != INODE_BLOCK(inode))
+					break;
+			write_inodes(inode->i_dev,INODE_BLOCK(inode),list+i,j-i);
+		}
 	}
 }
 
+/*
+ * block_goal() gives the zone new_block() should start looking at for
+ * block nr of the file: the one after the file's block nr-1, if it has
+ * one. Otherwise the zone of the directory the file was created in
+ * (i_goal), so that the files of a directory lie together. If that
+ * isn't known, new_block() starts where it last allocated.
+ */
+static int block_goal(struct m_inode * inode, int nr)
+{
+	int prev;
+
+	if (nr > 0 && (prev = _bmap(inode,nr-1,0)))
+		return prev+1;
+	return inode->i_goal;
+}
+
+/*
+ * Regular files get NR_PREALLOC zones claimed at a time: the first is
+ * used at once, and the rest are kept in i_pblock/i_pcount for the
+ * following blocks. A reservation that doesn't fit where the file goes
+ * on is given back, as is what's left of it on the last iput() or at
+ * truncate(). As the indirect block comes between two data blocks, the
+ * reservation still fits if it starts one after the goal.
+ */
+void discard_prealloc(struct m_inode * inode)
+{
+	while (inode->i_pcount) {
+		inode->i_pcount--;
+		free_block(inode->i_dev,inode->i_pblock++);
+	}
+}
+
+static int alloc_zone(struct m_inode * inode, int nr)
+{
+	int goal = block_goal(inode,nr);
+	int block;
+
+	if (inode->i_pcount) {
+		if (goal == inode->i_pblock || goal+1 == inode->i_pblock) {
+			block = inode->i_pblock++;
+			inode->i_pcount--;
+			zero_block(inode->i_dev,block);
+			return block;
+		}
+		discard_prealloc(inode);
+	}
+	if (!(block = new_block(inode->i_dev,goal)))
+		return 0;
+	if (S_ISREG(inode->i_mode)) {
+		inode->i_pblock = block+1;
+		inode->i_pcount = prealloc_blocks(inode->i_dev,block,
+			NR_PREALLOC-1);
+	}
+	return block;
+}
+
 //// 文件数据块映射到盘块的处理操作。（block位图处理函数，bmap - block map）
 // 参数：inode - 文件的i节点指针；block - 文件中的数据块号；create - 创建块标志。
 // 该函数把指定的文件数据块block对应到设备上逻辑块上，并返回逻辑块号。如果创建标志
 // 置位，则在设备上对应逻辑块不存在时就申请新磁盘块，返回文件数据块block对应在设备
 // 上的逻辑块号（盘块号）。
-static int _bmap(struct m_inode * inode,int block,int create)
+static int map_block(struct m_inode * inode,int block,int create)
 {
 	struct buffer_head * bh;
-	int i;
+	int i, nr = block;
 
     // 首先判断参数文件数据块号block的有效性。如果块号小于0，则停机。如果块号大于
     // 直接块数+间接块数+二次间接块数，超出文件系统表示范围，则停机。
 	if (block<0)
-		panic("_bmap: block<0");
+		panic("map_block: block<0");
 	if (block >= 7+512+512*512)
-		panic("_bmap: block>big");
+		panic("map_block: block>big");
     // 然后根据文件块号的大小值和是否设置了创建标志分别进行处理。如果该块号小于7，
     // 则使用直接块表示。如果创建标志置位，并且i节点中对应块的逻辑块(区段)字段为0，
     // 则相应设备申请一磁盘块（逻辑块），并且将磁盘上逻辑块号（盘块号）填入逻辑块
     // 字段中。然后设置i节点改变时间，置i节点已修改标志。然后返回逻辑块号。
 	if (block<7) {
 		if (create && !inode->i_zone[block])
-			if ((inode->i_zone[block]=new_block(inode->i_dev))) {
+			if ((inode->i_zone[block]=alloc_zone(inode,nr))) {
 				inode->i_ctime=CURRENT_TIME;
-				inode->i_dirt=1;
+				mark_inode_dirty(inode);
 			}
 		return inode->i_zone[block];
 	}
@@ -129,8 +422,8 @@ static int _bmap(struct m_inode * inode,int block,int create)
 	block -= 7;
 	if (block<512) {
 		if (create && !inode->i_zone[7])
-			if ((inode->i_zone[7]=new_block(inode->i_dev))) {
-				inode->i_dirt=1;
+			if ((inode->i_zone[7]=alloc_zone(inode,nr))) {
+				mark_inode_dirty(inode);
 				inode->i_ctime=CURRENT_TIME;
 			}
 		if (!inode->i_zone[7])
@@ -143,9 +436,9 @@ static int _bmap(struct m_inode * inode,int block,int create)
 			return 0;
 		i = ((unsigned short *) (bh->b_data))[block];
 		if (create && !i)
-			if ((i=new_block(inode->i_dev))) {
+			if ((i=alloc_zone(inode,nr))) {
 				((unsigned short *) (bh->b_data))[block]=i;
-				bh->b_dirt=1;
+				mark_buffer_dirty(bh);
 			}
         // 最后释放该间接块占用的缓冲块，并返回磁盘上新申请或原有的对应block的逻辑块号。
 		brelse(bh);
@@ -160,8 +453,8 @@ static int _bmap(struct m_inode * inode,int block,int create)
     // 间接块，于是映射磁盘块失败，返回0退出。
 	block -= 512;
 	if (create && !inode->i_zone[8])
-		if ((inode->i_zone[8]=new_block(inode->i_dev))) {
-			inode->i_dirt=1;
+		if ((inode->i_zone[8]=alloc_zone(inode,nr))) {
+			mark_inode_dirty(inode);
 			inode->i_ctime=CURRENT_TIME;
 		}
 	if (!inode->i_zone[8])
@@ -175,9 +468,9 @@ static int _bmap(struct m_inode * inode,int block,int create)
 		return 0;
 	i = ((unsigned short *)bh->b_data)[block>>9];
 	if (create && !i)
-		if ((i=new_block(inode->i_dev))) {
+		if ((i=alloc_zone(inode,nr))) {
 			((unsigned short *) (bh->b_data))[block>>9]=i;
-			bh->b_dirt=1;
+			mark_buffer_dirty(bh);
 		}
 	brelse(bh);
     // 如果二次间接块的二级块块号为0，表示申请磁盘块失败或者原来对应块号就为0，则返回
@@ -191,9 +484,9 @@ static int _bmap(struct m_inode * inode,int block,int create)
     // 最终存放数据信息的块。并让二级块中的第block项等于该新逻辑块块号(i)。然后置位二级块
     // 的已修改标志。
 	if (create && !i)
-		if ((i=new_block(inode->i_dev))) {
+		if ((i=alloc_zone(inode,nr))) {
 			((unsigned short *) (bh->b_data))[block&511]=i;
-			bh->b_dirt=1;
+			mark_buffer_dirty(bh);
 		}
     // 最后释放该二次间接块的二级块，返回磁盘上新申请的或原有的对应block的逻辑块号。
 	brelse(bh);
@@ -203,8 +496,56 @@ static int _bmap(struct m_inode * inode,int block,int create)
 //// 取文件数据块block在设备上对应的逻辑块号。
 // 参数：inode - 文件的内存i节点指针；block - 文件中的数据块号。
 // 若操作成功则返回对应的逻辑块号，否则返回0.
+/*
+ * Each inode remembers one extent: the run of file blocks starting at
+ * i_ext_lblock that sit in consecutive zones from i_ext_pblock on. A
+ * block inside it is mapped without reading the indirect blocks, and
+ * a block just after it that turns out to follow on makes it longer.
+ * Holes are never in it, so allocating blocks can't make it wrong:
+ * only truncate() has to throw it away.
+ */
+static int _bmap(struct m_inode * inode,int block,int create)
+{
+	int i;
+
+	if (inode->i_ext_len && block >= inode->i_ext_lblock &&
+	    block < inode->i_ext_lblock + inode->i_ext_len)
+		return inode->i_ext_pblock + (block - inode->i_ext_lblock);
+	if (!(i = map_block(inode,block,create)))
+		return 0;
+	if (inode->i_ext_len && inode->i_ext_len < 0xffff &&
+	    block == inode->i_ext_lblock + inode->i_ext_len &&
+	    i == inode->i_ext_pblock + inode->i_ext_len)
+		inode->i_ext_len++;
+	else {
+		inode->i_ext_lblock = block;
+		inode->i_ext_pblock = i;
+		inode->i_ext_len = 1;
+	}
+	return i;
+}
+
+static struct buffer_head * find_delay(struct m_inode * inode, int block);
+
+/*
+ * bmap() is for those who read the zone itself (do_no_page(), say), so
+ * a block whose data is still delayed is given its zone first.
+ */
 int bmap(struct m_inode * inode,int block)
 {
+	if (find_delay(inode,block))
+		commit_delayed(inode);
+	return _bmap(inode,block,0);
+}
+
+/*
+ * bmap_nodelay() is for readahead: a delayed block has nothing on the
+ * disk to read yet, so it gives 0, and nothing is committed.
+ */
+int bmap_nodelay(struct m_inode * inode,int block)
+{
+	if (find_delay(inode,block))
+		return 0;
 	return _bmap(inode,block,0);
 }
 
@@ -216,6 +557,275 @@ int create_block(struct m_inode * inode, int block)
 	return _bmap(inode,block,1);
 }
 
+/*
+ * Delayed allocation: a write to a block of a regular file that has no
+ * zone yet goes to a buffer of its own (b_delay set, b_dev 0), kept on
+ * the inode's i_delay list in block order. The zones are only picked
+ * when the data has to go out - by the flusher once it's bdf_age old,
+ * at sync(), on the last iput() - and then for all of the file at once
+ * and in block order, so block_goal() and the preallocation lay it out
+ * in one run. A file that is removed before that never gets any.
+ *
+ * The buffer lock keeps out everybody else while a delayed block is
+ * written to, read or given its zone, and the list is looked at before
+ * the zones: a block that is on the list may already be mapped, but
+ * its data isn't there until it has come off the list again.
+ *
+ * Only so many buffers may be held like this. Each delayed block has
+ * the zones it will need reserved in the super block (s_reserved, the
+ * count is kept in b_delay), and new_block() and prealloc_blocks()
+ * leave those alone, so a commit always finds its zones. When there
+ * aren't enough free zones left to reserve, the write allocates at
+ * once, as before, and gets ENOSPC from there.
+ */
+#define MAX_DELAYED (NR_BUFFERS/4)
+
+static int nr_delayed = 0;
+
+/*
+ * delay_zones() is how many zones block may need when it is committed:
+ * its own, and the indirect blocks on the way to it that may be missing.
+ */
+static int delay_zones(struct m_inode * inode, int block)
+{
+	if (block < 7)
+		return 1;
+	if (block < 7+512)
+		return inode->i_zone[7] ? 1 : 2;
+	return inode->i_zone[8] ? 2 : 3;
+}
+
+static void reserve_zones(int dev, int n)
+{
+	struct super_block * sb;
+
+	if ((sb = get_super(dev)))
+		sb->s_reserved += n;
+}
+
+static inline void lock_delay(struct buffer_head * bh)
+{
+	cli();
+	while (bh->b_lock)
+		sleep_on(&bh->b_wait);
+	bh->b_lock=1;
+	sti();
+}
+
+static struct buffer_head * find_delay(struct m_inode * inode, int block)
+{
+	struct buffer_head * bh;
+
+	for (bh = inode->i_delay ; bh ; bh = bh->b_next_delay)
+		if (bh->b_blocknr >= block)
+			return (bh->b_blocknr == block) ? bh : NULL;
+	return NULL;
+}
+
+static void add_delay(struct m_inode * inode, struct buffer_head * bh,
+	int zones)
+{
+	struct buffer_head ** p;
+
+	if (!inode->i_delay)
+		inode->i_delaytime = jiffies;
+	if (inode->i_dlast && inode->i_dlast->b_blocknr < bh->b_blocknr)
+		p = &inode->i_dlast->b_next_delay;
+	else
+		for (p = &inode->i_delay ; *p ; p = &(*p)->b_next_delay)
+			if ((*p)->b_blocknr > bh->b_blocknr)
+				break;
+	bh->b_next_delay = *p;
+	*p = bh;
+	if (!bh->b_next_delay)
+		inode->i_dlast = bh;
+	bh->b_delay = zones;
+	bh->b_count++;		/* the list's */
+	nr_delayed++;
+}
+
+static void remove_delay(struct m_inode * inode, struct buffer_head * bh)
+{
+	struct buffer_head ** p, * prev = NULL;
+
+	for (p = &inode->i_delay ; *p ; prev = *p, p = &(*p)->b_next_delay)
+		if (*p == bh) {
+			*p = bh->b_next_delay;
+			break;
+		}
+	if (inode->i_dlast == bh)
+		inode->i_dlast = prev;
+	bh->b_next_delay = NULL;
+	bh->b_delay = 0;
+	put_buffer(bh);
+	nr_delayed--;
+}
+
+/*
+ * delayed_block() returns the delayed buffer of 'block', locked and
+ * held, or NULL if there is none. With 'create' set, a block that has
+ * no zone gets one if it can. Give it back with release_delayed().
+ */
+struct buffer_head * delayed_block(struct m_inode * inode, int block,
+	int create)
+{
+	struct buffer_head * bh, * new = NULL;
+	struct super_block * sb;
+	int nr, zones = 0;
+
+repeat:
+	if ((bh = find_delay(inode,block))) {
+		if (new) {
+			reserve_zones(inode->i_dev,-zones);
+			brelse(new);
+			new = NULL;
+		}
+		bh->b_count++;
+		lock_delay(bh);
+		if (bh->b_delay)
+			return bh;
+		release_delayed(bh);	/* it got its zone meanwhile */
+		goto repeat;
+	}
+	if (!create || !S_ISREG(inode->i_mode))
+		return NULL;
+	nr = _bmap(inode,block,0);
+	if (find_delay(inode,block))
+		goto repeat;
+	if (nr) {
+		if (new) {
+			reserve_zones(inode->i_dev,-zones);
+			brelse(new);
+		}
+		return NULL;
+	}
+	if (!new) {
+		if (nr_delayed >= MAX_DELAYED) {
+			if (!inode->i_delay || commit_delayed(inode))
+				return NULL;
+			goto repeat;
+		}
+		zones = delay_zones(inode,block);
+		if (!(sb = get_super(inode->i_dev)) ||
+		    count_map(sb,1,sb->s_reserved+zones) < sb->s_reserved+zones)
+			return NULL;
+		sb->s_reserved += zones;
+		new = get_delay_buffer();
+		goto repeat;
+	}
+	new->b_blocknr = block;
+	new->b_lock = 1;
+	add_delay(inode,new,zones);
+	return new;
+}
+
+void release_delayed(struct buffer_head * bh)
+{
+	bh->b_lock = 0;
+	wake_up(&bh->b_wait);
+	brelse(bh);
+}
+
+/*
+ * commit_delayed() gives the delayed blocks of the inode their zones
+ * and moves the data into the real buffers, which are then written out
+ * as usual. The zones were reserved, so this only fails if a map or an
+ * indirect block can't be read: then the block stays delayed, and the
+ * error is returned.
+ */
+int commit_delayed(struct m_inode * inode)
+{
+	struct buffer_head * bh, * dbh;
+	int nr;
+
+	while ((dbh = inode->i_delay)) {
+		dbh->b_count++;
+		lock_delay(dbh);
+		if (dbh->b_delay) {
+			reserve_zones(inode->i_dev,-dbh->b_delay);
+			if (!(nr = create_block(inode,dbh->b_blocknr))) {
+				reserve_zones(inode->i_dev,dbh->b_delay);
+				release_delayed(dbh);
+				printk("commit_delayed: can't map block %d on dev %04x\n\r",
+					dbh->b_blocknr,inode->i_dev);
+				return -EIO;
+			}
+			bh = getblk(inode->i_dev,nr);
+			memcpy(bh->b_data,dbh->b_data,BLOCK_SIZE);
+			bh->b_uptodate = 1;
+			mark_buffer_dirty(bh);
+			brelse(bh);
+			remove_delay(inode,dbh);
+		}
+		release_delayed(dbh);
+	}
+	return 0;
+}
+
+void discard_delayed(struct m_inode * inode)
+{
+	struct buffer_head * dbh;
+
+	while ((dbh = inode->i_delay)) {
+		dbh->b_count++;
+		lock_delay(dbh);
+		if (dbh->b_delay) {
+			reserve_zones(inode->i_dev,-dbh->b_delay);
+			remove_delay(inode,dbh);
+		}
+		release_delayed(dbh);
+	}
+}
+
+/*
+ * sync_delayed() commits the inodes whose delayed data has waited for
+ * 'age' ticks or more, all of them if age is 0.
+ */
+void sync_delayed(long age)
+{
+	struct m_inode * inode;
+
+	for (inode = all_inodes ; inode ; inode = inode->i_next_all) {
+		if (!inode->i_delay || !inode->i_count)
+			continue;
+		if ((long) (jiffies - inode->i_delaytime) < age)
+			continue;
+		inode->i_count++;
+		commit_delayed(inode);
+		iput(inode);
+	}
+}
+
+/*
+ * update_atime() is called when a file or directory is read. Without
+ * mount flags it does what the callers always did: the access time is
+ * set, but the inode is only dirtied if 'dirty' is set (as by namei()),
+ * so reads and opens don't cause inode writes of their own. With
+ * MS_NOATIME it is left alone. With MS_RELATIME it is only set if it's
+ * no later than the last change, or a day old, and as that is seldom,
+ * the inode is then always dirtied so that the time gets to the disk.
+ */
+void update_atime(struct m_inode * inode, int dirty)
+{
+	struct super_block * sb;
+
+	if (inode->i_pipe || !inode->i_dev)
+		return;
+	if ((sb = get_super(inode->i_dev)) && sb->s_flags) {
+		if ((sb->s_flags & MS_NOATIME) ||
+		    (inode->i_atime > inode->i_mtime &&
+		     inode->i_atime > inode->i_ctime &&
+		     CURRENT_TIME - inode->i_atime < 24*60*60)) {
+			io_stat.atime_skipped++;
+			return;
+		}
+		dirty = 1;
+	}
+	inode->i_atime = CURRENT_TIME;
+	if (dirty)
+		mark_inode_dirty(inode);
+}
+
 //// 放回(放置)一个i节点引用计数值递减1，并且若是管道i节点，则唤醒等待的进程。
 // 若是块设备文件i节点则刷新设备。并且若i节点的链接计数为0，则释放该i节点占用
 // 的所有磁盘逻辑块，并释放该i节点。
@@ -238,14 +848,16 @@ void iput(struct m_inode * inode)
 			return;
 		free_page(inode->i_size);
 		inode->i_count=0;
-		inode->i_dirt=0;
+		clear_dirty(inode);
 		inode->i_pipe=0;
+		put_first_unused(inode);
 		return;
 	}
     // 如果i节点对应的设备号 ＝ 0，则将此节点的引用计数递减1，返回。例如用于管道操作
     // 的i节点，其i节点的设备号为0.
 	if (!inode->i_dev) {
-		inode->i_count--;
+		if (!--inode->i_count)
+			put_first_unused(inode);
 		return;
 	}
     // 如果是块设备文件的i节点，此时逻辑块字段0(i_zone[0])中是设备号，则刷新该设备。
@@ -263,6 +875,21 @@ repeat:
 		inode->i_count--;
 		return;
 	}
+	if (inode->i_delay) {
+		/* we can sleep - so do again. If the data can't be given */
+		/* its zones, there's nowhere left to keep it */
+		if (!inode->i_nlinks || commit_delayed(inode)) {
+			if (inode->i_nlinks)
+				printk("iput: delayed data of inode %d on dev %04x lost\n\r",
+					inode->i_num,inode->i_dev);
+			discard_delayed(inode);
+		}
+		goto repeat;
+	}
+	if (inode->i_pcount) {
+		discard_prealloc(inode);	/* we can sleep - so do again */
+		goto repeat;
+	}
 	if (!inode->i_nlinks) {
 		truncate(inode);
 		free_inode(inode);
@@ -280,6 +907,7 @@ repeat:
     // 没有被修改过。因此此时只要把i节点引用计数递减1，返回。此时该i节点的i_count=0,
     // 表示已释放。
 	inode->i_count--;
+	put_last_unused(inode);
 	return;
 }
 
@@ -288,32 +916,20 @@ repeat:
 struct m_inode * get_empty_inode(void)
 {
 	struct m_inode * inode;
-	static struct m_inode * last_inode = inode_table;
-	int i;
 
 	do {
-        // 在初始化last_inode指针指向i节点表头一项后循环扫描整个i节点表。如果last_inode
-        // 已经指向i节点表的最后一项之后，则让其重新指向i节点表开始处，以继续循环寻找空闲
-        // i节点项。如果last_inode所指向的i节点的计数值为0，则说明可能找到空闲i节点项。
-        // 让inode指向该i节点。如果该i节点的已修改标志和锁定标志均为0，则我们可以使用该i
-        // 节点，于是退出for循环。
-		inode = NULL;
-		for (i = NR_INODE; i ; i--) {
-			if (++last_inode >= inode_table + NR_INODE)
-				last_inode = inode_table;
-			if (!last_inode->i_count) {
-				inode = last_inode;
-				if (!inode->i_dirt && !inode->i_lock)
-					break;
-			}
-		}
-        // 如果没有找到空闲i节点（inode=NULL）,则将i节点表打印出来供调试使用，并停机。
-		if (!inode) {
-			for (i=0 ; i<NR_INODE ; i++)
-				printk("%04x: %6d\t",inode_table[i].i_dev,
-					inode_table[i].i_num);
+/* grow the table if there's no empty inode left and we still may */
+		if ((!unused_list || unused_list->i_dev) && nr_inodes < max_inodes)
+			grow_inodes();
+		if (!unused_list)
 			panic("No free inodes in mem");
-		}
+/* the least recently used clean inode, or failing that the lru one */
+		inode = unused_list;
+		do {
+			if (!inode->i_dirt && !inode->i_lock)
+				break;
+			inode = inode->i_next_free;
+		} while (inode != unused_list);
         // 等待该i节点解锁，如果该i节点已修改标志被置位的话，则将该i节点刷新，因为刷新时
         // 可能会睡眠，因此需要再次循环等待该i节点解锁。
 		wait_on_inode(inode);
@@ -325,7 +941,8 @@ struct m_inode * get_empty_inode(void)
         // 说明已找到符合要求的空闲i节点项。则将该i节点项内容清零，并置引用计数为1，
         // 返回该i节点指针。
 	} while (inode->i_count);
-	memset(inode,0,sizeof(*inode));
+	clear_inode(inode);
+	remove_from_unused(inode);
 	inode->i_count = 1;
 	return inode;
 }
@@ -345,6 +962,7 @@ struct m_inode * get_pipe_inode(void)
 		return NULL;
 	if (!(inode->i_size=get_free_page())) {
 		inode->i_count = 0;
+		put_first_unused(inode);
 		return NULL;
 	}
     // 然后设置该i节点的引用计数为2，并复位管道头尾指针。i节点逻辑块号数组i_zone[]
@@ -364,70 +982,65 @@ struct m_inode * get_pipe_inode(void)
 // 并返回该i节点指针。
 struct m_inode * iget(int dev,int nr)
 {
-	struct m_inode * inode, * empty;
+	struct m_inode * inode, * empty = NULL;
 
     // 首先判断参数的有效性。若设备号是0，则表明内核代码有问题，显示出错信息并停机。
-    // 然后预先从i节点表中取一个空闲i节点备用。
 	if (!dev)
 		panic("iget with dev==0");
-	empty = get_empty_inode();
-    // 接着扫描i节点表。寻找参数指定节点号nr的i节点。并递增该节点的引用次数。如果当
-    // 前扫描i节点的设备号不等于指定的设备号或者节点号不等于指定的节点号，则继续扫描。
-	inode = inode_table;
-	while (inode < NR_INODE+inode_table) {
-		if (inode->i_dev != dev || inode->i_num != nr) {
-			inode++;
-			continue;
-		}
-        // 如果找到指定设备号dev和节点号nr的i节点，则等待该节点解锁。在等待该节点解
-        // 锁过程中，i节点表可能会发生变化。所以再次进行上述相同判断。如果发生了变化，
-        // 则再次重新扫描整个i节点表。
-		wait_on_inode(inode);
-		if (inode->i_dev != dev || inode->i_num != nr) {
-			inode = inode_table;
-			continue;
+repeat:
+    // 在散列表中寻找指定设备号dev和节点号nr的i节点。如果没有找到，则取一个空闲i节点
+    // 备用。因为取空闲i节点时可能会睡眠，所以取得后需要再查找一次散列表。
+	if (!(inode = find_inode(dev,nr))) {
+		if (!empty) {
+			if (!(empty = get_empty_inode()))
+				return NULL;
+			goto repeat;
 		}
-        // 到这里表示找到相应的i节点。于是将该i节点引用计数增1.然后再做进一步检查，看它
-        // 是否是另一个文件系统的安装点。若是则寻找被安装文件系统根节点并返回。如果
-        // 该i节点的确是其他文件系统的安装点，则在超级块表中搜寻安装在此i节点的超级块。
-        // 如果没有找到，则显示出错信息，并放回本函数开始时获取的空闲节点empty，
-        // 返回该i节点指针。
-		inode->i_count++;
-		if (inode->i_mount) {
-			int i;
+        // 仍然没有找到，则利用申请的空闲i节点empty建立该i节点，并从相应设备上读取该
+        // i节点信息，返回该i节点指针。
+		inode = empty;
+		inode->i_dev = dev;
+		inode->i_num = nr;
+		insert_inode_hash(inode);
+		read_inode(inode);
+		return inode;
+	}
+    // 如果找到了，则等待该节点解锁。在等待该节点解锁过程中，该i节点可能会被重新
+    // 使用。所以再次进行上述相同判断。如果发生了变化，则重新查找。
+	wait_on_inode(inode);
+	if (inode->i_dev != dev || inode->i_num != nr)
+		goto repeat;
+    // 到这里表示找到相应的i节点。于是将该i节点引用计数增1（若原来没人使用，则把它从
+    // 未使用i节点链表中取下）。然后再做进一步检查，看它是否是另一个文件系统的安装点。
+    // 若是则寻找被安装文件系统根节点并返回。如果该i节点的确是其他文件系统的安装点，
+    // 则在超级块表中搜寻安装在此i节点的超级块。如果没有找到，则显示出错信息，并放回
+    // 本函数开始时获取的空闲节点empty，返回该i节点指针。
+	if (!inode->i_count)
+		remove_from_unused(inode);
+	inode->i_count++;
+	if (inode->i_mount) {
+		int i;
 
-			for (i = 0 ; i<NR_SUPER ; i++)
-				if (super_block[i].s_imount==inode)
-					break;
-			if (i >= NR_SUPER) {
-				printk("Mounted inode hasn't got sb\n");
-				if (empty)
-					iput(empty);
-				return inode;
-			}
-            // 执行到这里表示已经找到安装到inode节点的文件系统超级块。于是将该i节点写盘
-            // 放回，并从安装在次i节点上的文件系统超级块中取设备号，并令i节点号为ROOT_INO，
-            // 即为1.然后重新扫描整个i节点表，以获取该被安装文件系统的根i节点信息。
-			iput(inode);
-			dev = super_block[i].s_dev;
-			nr = ROOT_INO;
-			inode = inode_table;
-			continue;
+		for (i = 0 ; i<NR_SUPER ; i++)
+			if (super_block[i].s_imount==inode)
+				break;
+		if (i >= NR_SUPER) {
+			printk("Mounted inode hasn't got sb\n");
+			if (empty)
+				iput(empty);
+			return inode;
 		}
-        // 最终我们找到了相应的i节点。因此可以放弃本函数开始处临时申请的空闲的i节点，返回
-        // 找到的i节点指针。
-		if (empty)
-			iput(empty);
-		return inode;
+        // 执行到这里表示已经找到安装到inode节点的文件系统超级块。于是将该i节点写盘
+        // 放回，并从安装在次i节点上的文件系统超级块中取设备号，并令i节点号为ROOT_INO，
+        // 即为1.然后重新查找，以获取该被安装文件系统的根i节点信息。
+		iput(inode);
+		dev = super_block[i].s_dev;
+		nr = ROOT_INO;
+		goto repeat;
 	}
-    // 如果我们在i节点表中没有找到指定的i节点，则利用前面申请的空闲i节点empty在i节点表中
-    // 建立该i节点。并从相应设备上读取该i节点信息，返回该i节点指针。
-	if (!empty)
-		return (NULL);
-	inode=empty;
-	inode->i_dev = dev;
-	inode->i_num = nr;
-	read_inode(inode);
+    // 最终我们找到了相应的i节点。因此可以放弃临时申请的空闲的i节点，返回找到的i节点指针。
+	if (empty)
+		iput(empty);
 	return inode;
 }
 
@@ -496,8 +1109,8 @@ static void write_inode(struct m_inode * inode)
 			*(struct d_inode *)inode;
     // 然后置缓冲区已修改标志，而i节点内容已经与缓冲区中的一致，因此修改标志置零。然后释放该
     // 含有i节点的缓冲区，并解锁该i节点。
-	bh->b_dirt=1;
-	inode->i_dirt=0;
+	mark_buffer_dirty(bh);
+	clear_dirty(inode);
 	brelse(bh);
 	unlock_inode(inode);
 }
@@ -222,6 +222,19 @@ static struct buffer_head * find_entry(struct m_inode ** dir,
 	return NULL;
 }
 
+/*
+ * forget_entry() drops the name in 'de' from the directory cache. It
+ * has to be called whenever a name is added to or removed from 'dir'.
+ */
+static void forget_entry(struct m_inode * dir, struct dir_entry * de)
+{
+	int len;
+
+	for (len=0 ; len<NAME_LEN && de->name[len] ; len++)
+		/* nothing */ ;
+	dcache_invalidate(dir->i_dev,dir->i_num,de->name,len);
+}
+
 /*
  *	add_entry()
  *
@@ -304,7 +317,7 @@ static struct buffer_head * add_entry(struct m_inode * dir,
 		if (i*sizeof(struct dir_entry) >= dir->i_size) {
 			de->inode=0;
 			dir->i_size = (i+1)*sizeof(struct dir_entry);
-			dir->i_dirt = 1;
+			mark_inode_dirty(dir);
 			dir->i_ctime = CURRENT_TIME;
 		}
         // 若当前搜索的目录项de的i节点为空，则表示找到一个还未使用的空闲目录项
@@ -315,7 +328,8 @@ static struct buffer_head * add_entry(struct m_inode * dir,
 			dir->i_mtime = CURRENT_TIME;
 			for (i=0; i < NAME_LEN ; i++)
 				de->name[i]=(i<namelen)?get_fs_byte(name+i):0;
-			bh->b_dirt = 1;
+			forget_entry(dir,de);
+			mark_buffer_dirty(bh);
 			*res_dir = de;
 			return bh;
 		}
@@ -328,6 +342,44 @@ static struct buffer_head * add_entry(struct m_inode * dir,
 	return NULL;
 }
 
+/*
+ *	lookup()
+ *
+ * returns the inode number of a name in the directory, or 0 if it isn't
+ * there. Unlike find_entry() it goes through the directory cache, so it
+ * is what the path walks use. '.' and '..' aren't cached, as '..' can
+ * change 'dir' (see find_entry()).
+ */
+static int lookup(struct m_inode ** dir, const char * name, int namelen)
+{
+	char buf[NAME_LEN];
+	struct buffer_head * bh;
+	struct dir_entry * de;
+	int i,inr,cache;
+	unsigned long seq;
+
+#ifndef NO_TRUNCATE
+	if (namelen > NAME_LEN)
+		namelen = NAME_LEN;
+#endif
+	cache = (namelen > 0 && namelen <= NAME_LEN);
+	for (i=0 ; cache && i<namelen ; i++)
+		buf[i] = get_fs_byte(name+i);
+	if (cache && buf[0]=='.' && (namelen==1 || (namelen==2 && buf[1]=='.')))
+		cache = 0;
+	if (cache && dcache_lookup((*dir)->i_dev,(*dir)->i_num,buf,namelen,&inr))
+		return inr;
+	seq = dcache_seq;
+	inr = 0;
+	if ((bh = find_entry(dir,name,namelen,&de))) {
+		inr = de->inode;
+		brelse(bh);
+	}
+	if (cache && seq == dcache_seq)
+		dcache_add((*dir)->i_dev,(*dir)->i_num,buf,namelen,inr);
+	return inr;
+}
+
 /*
  *	get_dir()
  *
@@ -342,9 +394,7 @@ static struct m_inode * get_dir(const char * pathname)
 	char c;
 	const char * thisname;
 	struct m_inode * inode;
-	struct buffer_head * bh;
 	int namelen,inr,idev;
-	struct dir_entry * de;
 
     // 搜索操作会从当前任务结构中设置的根（或伪根）i节点或当前工作目录i节点
     // 开始，因此首先需要判断进程的根i节点指针和当前工作目录i节点指针是否有效。
@@ -398,13 +448,11 @@ static struct m_inode * get_dir(const char * pathname)
         // NULL退出。然后在找到的目录项中取出其i节点号inr和设备号idev，释放包含该目录
         // 项的高速缓冲块并放回该i节点。然后去节点号inr的i节点inode，并以该目录项为
         // 当前目录继续循环处理路径名中的下一目录名部分（或文件名）。
-		if (!(bh = find_entry(&inode,thisname,namelen,&de))) {
+		if (!(inr = lookup(&inode,thisname,namelen))) {
 			iput(inode);
 			return NULL;
 		}
-		inr = de->inode;                        // 当前目录名部分的i节点号
 		idev = inode->i_dev;
-		brelse(bh);
 		iput(inode);
 		if (!(inode = iget(idev,inr)))          // 取i节点内容。
 			return NULL;
@@ -457,8 +505,6 @@ struct m_inode * namei(const char * pathname)
 	const char * basename;
 	int inr,dev,namelen;
 	struct m_inode * dir;
-	struct buffer_head * bh;
-	struct dir_entry * de;
 
     // 首先查找指定路径的最顶层目录的目录名并得到其i节点，若不存在，则返回NULL退出。
     // 如果返回的最顶层名字长度是0，则表示该路径名以一个目录名为最后一项。因此我们
@@ -472,23 +518,18 @@ struct m_inode * namei(const char * pathname)
     // src/目录名的i节点。因为函数dir_namei()把不以'/'结束的最后一个名字当作一个文件名
     // 来看待，所以这里需要单独对这种情况使用寻找目录项i节点函数find_entry()进行处理。
     // 此时de中含有寻找到的目录项指针，而dir是包含该目录项的目录的i节点指针。
-	bh = find_entry(&dir,basename,namelen,&de);
-	if (!bh) {
+	if (!(inr = lookup(&dir,basename,namelen))) {
 		iput(dir);
 		return NULL;
 	}
     // 接着取该目录项的i节点号和设备号，并释放包含该目录项的高速缓冲块并返回目录i节点。
     // 然后取对应节点号的i节点，修改其被访问时间为当前时间，并置已修改标志。最后返回
     // 该i节点指针。
-	inr = de->inode;
 	dev = dir->i_dev;
-	brelse(bh);
 	iput(dir);
 	dir=iget(dev,inr);
-	if (dir) {
-		dir->i_atime=CURRENT_TIME;
-		dir->i_dirt=1;
-	}
+	if (dir)
+		update_atime(dir,1);
 	return dir;
 }
 
@@ -542,8 +583,8 @@ int open_namei(const char * pathname, int flag, int mode,
     // 则表示没有找到对应文件名的目录项，因此只可能是创建文件操作。此时如果不是创建文件，则
     // 放回该目录的i节点，返回出错号退出。如果用户在该目录没有写的权力，则放回该目录的i节点，
     // 返回出错号退出。
-	bh = find_entry(&dir,basename,namelen,&de);
-	if (!bh) {
+	inr = lookup(&dir,basename,namelen);
+	if (!inr) {
 		if (!(flag & O_CREAT)) {
 			iput(dir);
 			return -ENOENT;
@@ -563,7 +604,8 @@ int open_namei(const char * pathname, int flag, int mode,
 		}
 		inode->i_uid = current->euid;
 		inode->i_mode = mode;
-		inode->i_dirt = 1;
+		inode->i_goal = dir->i_zone[0];
+		mark_inode_dirty(inode);
 		bh = add_entry(dir,basename,namelen,&de);
         // 如果返回的应该含有新目录项的高速缓冲区指针为NULL，则表示添加目录项操作失败。于是
         // 将该新i节点的引用计数减1，放回该i节点与目录的i节点并返回出错码退出。否则说明添加
@@ -577,7 +619,7 @@ int open_namei(const char * pathname, int flag, int mode,
 			return -ENOSPC;
 		}
 		de->inode = inode->i_num;
-		bh->b_dirt = 1;
+		mark_buffer_dirty(bh);
 		brelse(bh);
 		iput(dir);
 		*res_inode = inode;
@@ -586,9 +628,7 @@ int open_namei(const char * pathname, int flag, int mode,
     // 若上面在目录中取文件名对应目录项结构的操作成功（即bh不为NULL），则说明指定打开的文件已
     // 经存在。于是取出该目录项的i节点号和其所在设备号，并释放该高速缓冲区以及放回目录的i节点
     // 如果此时堵在操作标志O_EXCL置位，但现在文件已经存在，则返回文件已存在出错码退出。
-	inr = de->inode;
 	dev = dir->i_dev;
-	brelse(bh);
 	iput(dir);
 	if (flag & O_EXCL)
 		return -EEXIST;
@@ -603,7 +643,7 @@ int open_namei(const char * pathname, int flag, int mode,
 	}
     // 接着我们更新该i节点的访问时间字段值为当前时间。如果设立了截0标志，则将该i节点的文件长度
     // 截0.最后返回该目录项i节点的指针，并返回0（成功）。
-	inode->i_atime = CURRENT_TIME;
+	update_atime(inode,0);
 	if (flag & O_TRUNC)
 		truncate(inode);
 	*res_inode = inode;
@@ -661,7 +701,7 @@ int sys_mknod(const char * filename, int mode, int dev)
 	if (S_ISBLK(mode) || S_ISCHR(mode))
 		inode->i_zone[0] = dev;
 	inode->i_mtime = inode->i_atime = CURRENT_TIME;
-	inode->i_dirt = 1;
+	mark_inode_dirty(inode);
     // 接着为这个新的i节点在目录中新添加一个目录项。如果失败（包含该目录项的高速缓冲块指针为
     // NULL），则放回目录的i节点，吧所申请的i节点引用连接计数复位，并放回该i节点，返回出错码退出。
 	bh = add_entry(dir,basename,namelen,&de);
@@ -674,7 +714,7 @@ int sys_mknod(const char * filename, int mode, int dev)
     // 现在添加目录项操作也成功了，于是我们来设置这个目录项内容。令该目录项的i节点字段于新i节点
     // 号，并置高速缓冲区已修改标志，放回目录和新的i节点，释放高速缓冲区，最后返回0（成功）。
 	de->inode = inode->i_num;
-	bh->b_dirt = 1;
+	mark_buffer_dirty(bh);
 	iput(dir);
 	iput(inode);
 	brelse(bh);
@@ -726,18 +766,18 @@ int sys_mkdir(const char * pathname, int mode)
 		return -ENOSPC;
 	}
 	inode->i_size = 32;
-	inode->i_dirt = 1;
+	mark_inode_dirty(inode);
 	inode->i_mtime = inode->i_atime = CURRENT_TIME;
     // 接着为该新i节点申请一用于保存目录项数据的磁盘块，用于保存目录项结构信息。并令i节
     // 点的第一个直接块指针等于该块号。如果申请失败则放回对应目录的i节点；复位新申请的i
     // 节点连接计数；放回该新的i节点，返回没有空间出错码退出。否则置该新的i节点已修改标志。
-	if (!(inode->i_zone[0]=new_block(inode->i_dev))) {
+	if (!(inode->i_zone[0]=new_block(inode->i_dev,dir->i_zone[0]))) {
 		iput(dir);
 		inode->i_nlinks--;
 		iput(inode);
 		return -ENOSPC;
 	}
-	inode->i_dirt = 1;
+	mark_inode_dirty(inode);
     // 从设备上读取新申请的磁盘块（目的是吧对应块放到高速缓冲区中）。若出错，则放回对应
     // 目录的i节点；释放申请的磁盘块；复位新申请的i节点连接计数；放回该新的i节点，返回没有
     // 空间出错码退出。
@@ -760,10 +800,10 @@ int sys_mkdir(const char * pathname, int mode)
 	de->inode = dir->i_num;
 	strcpy(de->name,"..");
 	inode->i_nlinks = 2;
-	dir_block->b_dirt = 1;
+	mark_buffer_dirty(dir_block);
 	brelse(dir_block);
 	inode->i_mode = I_DIRECTORY | (mode & 0777 & ~current->umask);
-	inode->i_dirt = 1;
+	mark_inode_dirty(inode);
     // 现在我们在指定目录中新添加一个目录项，用于存放新建目录的i节点号和目录名。如果
     // 失败(包含该目录项的高速缓冲区指针为NULL)，则放回目录的i节点；所申请的i节点引用
     // 连接计数复位，并放回该i节点。返回出错码退出。
@@ -778,9 +818,9 @@ int sys_mkdir(const char * pathname, int mode)
     // 最后令该新目录项的i节点字段等于新i节点号，并置高速缓冲块已修改标志，放回目录和
     // 新的i节点，是否高速缓冲块，最后返回0(成功).
 	de->inode = inode->i_num;
-	bh->b_dirt = 1;
+	mark_buffer_dirty(bh);
 	dir->i_nlinks++;
-	dir->i_dirt = 1;
+	mark_inode_dirty(dir);
 	iput(dir);
 	iput(inode);
 	brelse(bh);
@@ -956,16 +996,18 @@ int sys_rmdir(const char * name)
     // 然后在置被删除目录i节点的连接 数为0(表示空闲)，并置i节点已修改标志。
 	if (inode->i_nlinks != 2)
 		printk("empty directory has nlink!=2 (%d)",inode->i_nlinks);
+	forget_entry(dir,de);
 	de->inode = 0;
-	bh->b_dirt = 1;
+	mark_buffer_dirty(bh);
 	brelse(bh);
+	dcache_invalidate_dir(inode->i_dev,inode->i_num);
 	inode->i_nlinks=0;
-	inode->i_dirt=1;
+	mark_inode_dirty(inode);
     // 再将包含被删除目录名的目录的i节点连接计数减一，修改其改变时间和修改时间为当前时间，并置该
     // 节点已修改标志。最后放回包含要删除目录名的目录i节点和该要修改目录的i节点，返回0（表示删除成功）。
 	dir->i_nlinks--;
 	dir->i_ctime = dir->i_mtime = CURRENT_TIME;
-	dir->i_dirt=1;
+	mark_inode_dirty(dir);
 	iput(dir);
 	iput(inode);
 	return 0;
@@ -1045,15 +1087,16 @@ int sys_unlink(const char * name)
 	}
     // 现在我们可以删除文件名对应的目录项了，于是将该文件名目录项中的i节点号字段置为0，
     // 表示释放该目录项，并设置包含该目录项的缓冲块已修改标志，释放该高速缓冲块。
+	forget_entry(dir,de);
 	de->inode = 0;
-	bh->b_dirt = 1;
+	mark_buffer_dirty(bh);
 	brelse(bh);
     // 然后把文件名对应i节点的链接数减1，置已修改标志，更新改变时间为当前时间。最后放回
     // 该i节点和目录的i节点，返回0(成功)。如果是文件的最后一个链接，即i节点链接数减1后等
     // 于0，并且此时没有进程正打开该文件，那么在调用iput()放回i节点时，该文件也将被删除，
     // 并释放所占用的设备空间。
 	inode->i_nlinks--;
-	inode->i_dirt = 1;
+	mark_inode_dirty(inode);
 	inode->i_ctime = CURRENT_TIME;
 	iput(inode);
 	iput(dir);
@@ -1128,14 +1171,14 @@ int sys_link(const char * oldname, const char * newname)
 		return -ENOSPC;
 	}
 	de->inode = oldinode->i_num;
-	bh->b_dirt = 1;
+	mark_buffer_dirty(bh);
 	brelse(bh);
 	iput(dir);
     // 再将原节点的链接计数加1，修改其改变时间为当前时间，并设置i节点已修改标志。最后
     // 放回原路径名的i节点，并返回0（成功）。
 	oldinode->i_nlinks++;
 	oldinode->i_ctime = CURRENT_TIME;
-	oldinode->i_dirt = 1;
+	mark_inode_dirty(oldinode);
 	iput(oldinode);
 	return 0;
 }
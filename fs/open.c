@@ -23,7 +23,21 @@
 // 定义在types.h中。
 int sys_ustat(int dev, struct ustat * ubuf)
 {
-	return -ENOSYS;
+	struct super_block * sb;
+	int i;
+
+	if (!(sb = get_super(dev)))
+		return -EINVAL;
+	verify_area(ubuf,sizeof (*ubuf));
+	count_map(sb,1,~0UL);
+	count_map(sb,0,~0UL);
+	put_fs_long(sb->s_free_zones,(unsigned long *) &ubuf->f_tfree);
+	put_fs_word(sb->s_free_inodes,(short *) &ubuf->f_tinode);
+	for (i=0 ; i<6 ; i++) {
+		put_fs_byte(0,ubuf->f_fname+i);
+		put_fs_byte(0,ubuf->f_fpack+i);
+	}
+	return 0;
 }
 
 //// 设置文件访问和修改时间
@@ -50,7 +64,7 @@ int sys_utime(char * filename, struct utimbuf * times)
     // 该i节点并返回0.
 	inode->i_atime = actime;
 	inode->i_mtime = modtime;
-	inode->i_dirt = 1;
+	mark_inode_dirty(inode);
 	iput(inode);
 	return 0;
 }
@@ -167,7 +181,7 @@ int sys_chmod(const char * filename,int mode)
 	}
     // 否则就重新设置该i节点的文件属性，并置该i节点的已修改标志。放回该i节点，返回0.
 	inode->i_mode = (mode & 07777) | (inode->i_mode & ~07777);
-	inode->i_dirt = 1;
+	mark_inode_dirty(inode);
 	iput(inode);
 	return 0;
 }
@@ -192,7 +206,7 @@ int sys_chown(const char * filename,int uid,int gid)
     // 标志，放回该节点，返回0.
 	inode->i_uid=uid;
 	inode->i_gid=gid;
-	inode->i_dirt=1;
+	mark_inode_dirty(inode);
 	iput(inode);
 	return 0;
 }
@@ -282,6 +296,7 @@ int sys_open(const char * filename,int flag,int mode)
 	f->f_count = 1;
 	f->f_inode = inode;
 	f->f_pos = 0;
+	f->f_ranext = f->f_raend = f->f_rawin = 0;
 	return (fd);
 }
 
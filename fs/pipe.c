@@ -44,8 +44,8 @@ int read_pipe(struct m_inode * inode, char * buf, int count)
 		size = PIPE_TAIL(*inode);
 		PIPE_TAIL(*inode) += chars;
 		PIPE_TAIL(*inode) &= (PAGE_SIZE-1);
-		while (chars-->0)
-			put_fs_byte(((char *)inode->i_size)[size++],buf++);
+		copy_to_user(buf,(char *)inode->i_size+size,chars);
+		buf += chars;
 	}
     // 当此次读管道操作结束，则唤醒等待该管道的进程，并返回读取的字节数。
 	wake_up(&inode->i_wait);
@@ -91,8 +91,8 @@ int write_pipe(struct m_inode * inode, char * buf, int count)
 		size = PIPE_HEAD(*inode);
 		PIPE_HEAD(*inode) += chars;
 		PIPE_HEAD(*inode) &= (PAGE_SIZE-1);
-		while (chars-->0)
-			((char *)inode->i_size)[size++]=get_fs_byte(buf++);
+		copy_from_user((char *)inode->i_size+size,buf,chars);
+		buf += chars;
 	}
     // 当此次写管道操作结束，则唤醒等待管道的进程，返回已写入的字节数，退出。
 	wake_up(&inode->i_wait);
@@ -149,6 +149,7 @@ int sys_pipe(unsigned long * fildes)
     // 模式置为写。最后将文件句柄数组复制到对应的用户空间数组中，成功返回0，退出。
 	f[0]->f_inode = f[1]->f_inode = inode;
 	f[0]->f_pos = f[1]->f_pos = 0;
+	f[0]->f_rawin = f[1]->f_rawin = 0;
 	f[0]->f_mode = 1;		/* read */
 	f[1]->f_mode = 2;		/* write */
 	put_fs_long(fd[0],0+fildes);
@@ -7,6 +7,7 @@
 #include <sys/stat.h>
 #include <errno.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 #include <linux/kernel.h>
 #include <linux/sched.h>
@@ -19,15 +20,15 @@ extern int read_pipe(struct m_inode * inode, char * buf, int count);
 // 写管道操作函数
 extern int write_pipe(struct m_inode * inode, char * buf, int count);
 // 块设备读操作函数
-extern int block_read(int dev, off_t * pos, char * buf, int count);
+extern int block_read(int dev, off_t * pos, char * buf, int count, int flags);
 // 块设备写操作函数
-extern int block_write(int dev, off_t * pos, char * buf, int count);
+extern int block_write(int dev, off_t * pos, char * buf, int count, int flags);
 // 读文件操作函数
 extern int file_read(struct m_inode * inode, struct file * filp,
-		char * buf, int count);
+		char * buf, int count, off_t * pos);
 // 写文件操作函数
 extern int file_write(struct m_inode * inode, struct file * filp,
-		char * buf, int count);
+		char * buf, int count, off_t * pos);
 
 //// 重定位文件读写指针系统调用
 // 参数fd是文件句柄，offset是新的文件读写指针偏移值，origin是便宜的起始位置，
@@ -37,6 +38,7 @@ int sys_lseek(unsigned int fd,off_t offset, int origin)
 {
 	struct file * file;
 	int tmp;
+	off_t old;
 
     // 首先判断函数提供的参数有效性。如果文件句柄值大于程序最多打开文件数NR_OPEN(20),
     // 或者该句柄的文件结构指针为空，或者对应文件结构的i节点字段为空，或者指定设备
@@ -47,6 +49,7 @@ int sys_lseek(unsigned int fd,off_t offset, int origin)
 		return -EBADF;
 	if (file->f_inode->i_pipe)
 		return -ESPIPE;
+	old = file->f_pos;
     // 然后根据设置的定位标志，分别重新定位文件读写指针。
 	switch (origin) {
         // origin = SEEK_SET,要求以文件起始处作为原点设置文件读写指针。若偏移值小于零，
@@ -72,81 +75,185 @@ int sys_lseek(unsigned int fd,off_t offset, int origin)
 		default:
 			return -EINVAL;
 	}
+/* a real seek ends any sequential read: drop the readahead window */
+	if (file->f_pos/BLOCK_SIZE != old/BLOCK_SIZE)
+		file->f_rawin = file->f_raend = 0;
 	return file->f_pos;
 }
 
-//// 读文件系统调用
-// 参数fd是文件句柄，buf是缓冲区，count是预读字节数
-int sys_read(unsigned int fd,char * buf,int count)
+/*
+ * do_read() and do_write() do the work of all the read and write calls,
+ * at *pos: sys_read() and sys_write() pass the file position, pread()
+ * and pwrite() one of their own, so that the file position isn't moved.
+ * Pipes and character devices (ttys) have no position to read or write
+ * at, so the positional calls get ESPIPE on them.
+ */
+static int do_read(struct file * file, char * buf, int count, off_t * pos)
 {
-	struct file * file;
-	struct m_inode * inode;
+	struct m_inode * inode = file->f_inode;
 
-    // 函数首先对参数有效性进行判断。如果文件句柄值大于程序最多打开文件数NR_OPEN，
-    // 或者需要读取的字节计数值小于0，或者该句柄的文件结构指针为空，则返回出错码并
-    // 退出。若需读取的字节数count等于0，则返回0退出。
-	if (fd>=NR_OPEN || count<0 || !(file=current->filp[fd]))
-		return -EINVAL;
-	if (!count)
-		return 0;
-    // 然后验证存放数据的缓冲区内存限制。并取文件的i节点。用于根据该i节点的属性，分
-    // 别调用相应的读操作函数。若是管道文件，并且是读管道文件模式，则进行读管道操作，
-    // 若成功则返回读取的字节数，否则返回出错码，退出。如果是字符型文件，则进行读
-    // 字符设备操作，并返回读取的字符数。如果是块设备文件，则执行块设备读操作，并
-    // 返回读取的字节数。
-	verify_area(buf,count);
-	inode = file->f_inode;
+	if ((inode->i_pipe || S_ISCHR(inode->i_mode)) && pos != &file->f_pos)
+		return -ESPIPE;
+    // 根据i节点的属性，分别调用相应的读操作函数。若是管道文件，并且是读管道文件模式，
+    // 则进行读管道操作，若成功则返回读取的字节数，否则返回出错码，退出。如果是字符型
+    // 文件，则进行读字符设备操作，并返回读取的字符数。如果是块设备文件，则执行块设备
+    // 读操作，并返回读取的字节数。
 	if (inode->i_pipe)
 		return (file->f_mode&1)?read_pipe(inode,buf,count):-EIO;
 	if (S_ISCHR(inode->i_mode))
-		return rw_char(READ,inode->i_zone[0],buf,count,&file->f_pos);
+		return rw_char(READ,inode->i_zone[0],buf,count,pos);
 	if (S_ISBLK(inode->i_mode))
-		return block_read(inode->i_zone[0],&file->f_pos,buf,count);
+		return block_read(inode->i_zone[0],pos,buf,count,file->f_flags);
     // 如果是目录文件或者是常规文件，则首先验证读取字节数count的有效性并进行调整(若
-    // 读去字节数加上文件当前读写指针值大于文件长度，则重新设置读取字节数为文件长度
-    // -当前读写指针值，若读取数等于0，则返回0退出)，然后执行文件读操作，返回读取的
-    // 字节数并退出。
+    // 读去字节数加上读写位置值大于文件长度，则重新设置读取字节数为文件长度-读写位置
+    // 值，若读取数等于0，则返回0退出)，然后执行文件读操作，返回读取的字节数并退出。
 	if (S_ISDIR(inode->i_mode) || S_ISREG(inode->i_mode)) {
-		if (count+file->f_pos > inode->i_size)
-			count = inode->i_size - file->f_pos;
+		if (count+*pos > inode->i_size)
+			count = inode->i_size - *pos;
 		if (count<=0)
 			return 0;
-		return file_read(inode,file,buf,count);
+		return file_read(inode,file,buf,count,pos);
 	}
     // 执行到这里，说明我们无法判断文件的属性。则打印节点文件属性，并返回出错码退出。
 	printk("(Read)inode->i_mode=%06o\n\r",inode->i_mode);
 	return -EINVAL;
 }
 
+static int do_write(struct file * file, char * buf, int count, off_t * pos)
+{
+	struct m_inode * inode = file->f_inode;
+
+	if ((inode->i_pipe || S_ISCHR(inode->i_mode)) && pos != &file->f_pos)
+		return -ESPIPE;
+    // 根据i节点属性，分别调用相应的写操作函数。若是管道文件，并且是写管道文件模式，
+    // 则进行写管道操作，若成功则返回写入的字节数，否则返回出错码退出。如果是字符设备
+    // 文件，则进行写字符设备操作，返回写入的字符数退出。如果是块设备文件，则进行块
+    // 设备写操作，并返回写入的字节数退出。若是常规文件，则执行文件写操作，并返回写入
+    // 的字节数，退出。
+	if (inode->i_pipe)
+		return (file->f_mode&2)?write_pipe(inode,buf,count):-EIO;
+	if (S_ISCHR(inode->i_mode))
+		return rw_char(WRITE,inode->i_zone[0],buf,count,pos);
+	if (S_ISBLK(inode->i_mode))
+		return block_write(inode->i_zone[0],pos,buf,count,file->f_flags);
+	if (S_ISREG(inode->i_mode))
+		return file_write(inode,file,buf,count,pos);
+    // 执行到这里，说明我们无法判断文件的属性。则打印节点文件属性，并返回出错码退出。
+	printk("(Write)inode->i_mode=%06o\n\r",inode->i_mode);
+	return -EINVAL;
+}
+
+//// 读文件系统调用
+// 参数fd是文件句柄，buf是缓冲区，count是预读字节数
+int sys_read(unsigned int fd,char * buf,int count)
+{
+	struct file * file;
+
+    // 函数首先对参数有效性进行判断。如果文件句柄值大于程序最多打开文件数NR_OPEN，
+    // 或者需要读取的字节计数值小于0，或者该句柄的文件结构指针为空，则返回出错码并
+    // 退出。若需读取的字节数count等于0，则返回0退出。
+	if (fd>=NR_OPEN || count<0 || !(file=current->filp[fd]))
+		return -EINVAL;
+	if (!count)
+		return 0;
+    // 然后验证存放数据的缓冲区内存限制，并在文件当前读写位置处读取。
+	verify_area(buf,count);
+	return do_read(file,buf,count,&file->f_pos);
+}
+
 //// 写文件系统调用
 // 参数fd是文件句柄，buf是用户缓冲区，count是欲写字节数。
 int sys_write(unsigned int fd,char * buf,int count)
 {
 	struct file * file;
-	struct m_inode * inode;
 
     // 同样地，我们首先判断函数参数的有效性。若果进程文件句柄值大于程序最多打开文件数
     // NR_OPEN，或者需要写入的字节数小于0，或者该句柄的文件结构指针为空，则返回出错码
-    // 并退出。如果需读取字节数count等于0，则返回0退出。
+    // 并退出。如果需读取字节数count等于0，则返回0退出。然后在文件当前读写位置处写入。
 	if (fd>=NR_OPEN || count <0 || !(file=current->filp[fd]))
 		return -EINVAL;
 	if (!count)
 		return 0;
-    // 然后验证存放数据的缓冲区内存限制。并取文件的i节点。用于根据该i节点属性，分别调
-    // 用相应的读操作函数。若是管道文件，并且是写管道文件模式，则进行写管道操作，若成
-    // 功则返回写入的字节数，否则返回出错码退出。如果是字符设备文件，则进行写字符设备
-    // 操作，返回写入的字符数退出。如果是块设备文件，则进行块设备写操作，并返回写入的
-    // 字节数退出。若是常规文件，则执行文件写操作，并返回写入的字节数，退出。
-	inode=file->f_inode;
-	if (inode->i_pipe)
-		return (file->f_mode&2)?write_pipe(inode,buf,count):-EIO;
-	if (S_ISCHR(inode->i_mode))
-		return rw_char(WRITE,inode->i_zone[0],buf,count,&file->f_pos);
-	if (S_ISBLK(inode->i_mode))
-		return block_write(inode->i_zone[0],&file->f_pos,buf,count);
-	if (S_ISREG(inode->i_mode))
-		return file_write(inode,file,buf,count);
-    // 执行到这里，说明我们无法判断文件的属性。则打印节点文件属性，并返回出错码退出。
-	printk("(Write)inode->i_mode=%06o\n\r",inode->i_mode);
-	return -EINVAL;
+	return do_write(file,buf,count,&file->f_pos);
+}
+
+/*
+ * readv() and writev() do the iovcnt buffers of 'iov' in turn, as one
+ * call: they stop at the first one that isn't done completely, and
+ * return what was done so far, or the error if nothing was.
+ */
+static int do_rwv(int rw, unsigned int fd, struct iovec * iov, int iovcnt)
+{
+	struct file * file;
+	char * buf;
+	int i, len, n, done = 0;
+
+	if (fd>=NR_OPEN || iovcnt<0 || !(file=current->filp[fd]))
+		return -EINVAL;
+	for (i=0 ; i<iovcnt ; i++,iov++) {
+		buf = (char *) get_fs_long((unsigned long *) &iov->iov_base);
+		len = (int) get_fs_long((unsigned long *) &iov->iov_len);
+		if (len < 0)
+			return done?done:-EINVAL;
+		if (!len)
+			continue;
+		if (rw == READ) {
+			verify_area(buf,len);
+			n = do_read(file,buf,len,&file->f_pos);
+		} else
+			n = do_write(file,buf,len,&file->f_pos);
+		if (n < 0)
+			return done?done:n;
+		done += n;
+		if (n < len)
+			break;
+	}
+	return done;
+}
+
+int sys_readv(unsigned int fd, struct iovec * iov, int iovcnt)
+{
+	return do_rwv(READ,fd,iov,iovcnt);
+}
+
+int sys_writev(unsigned int fd, struct iovec * iov, int iovcnt)
+{
+	return do_rwv(WRITE,fd,iov,iovcnt);
+}
+
+/*
+ * pread() and pwrite() read or write at 'pos', and leave the file
+ * position alone. A system call gets 3 arguments at most, so the buffer
+ * and its length come in one iovec: pread(fd,buf,count,pos) in the
+ * library is the system call pread(fd,&iov,pos).
+ */
+static int do_prw(int rw, unsigned int fd, struct iovec * iov, off_t pos)
+{
+	struct file * file;
+	char * buf;
+	int len;
+
+	if (fd>=NR_OPEN || !(file=current->filp[fd]))
+		return -EINVAL;
+	buf = (char *) get_fs_long((unsigned long *) &iov->iov_base);
+	len = (int) get_fs_long((unsigned long *) &iov->iov_len);
+	if (len < 0 || pos < 0)
+		return -EINVAL;
+	if (!len)
+		return 0;
+	if (rw == READ) {
+		verify_area(buf,len);
+		return do_read(file,buf,len,&pos);
+	}
+	return do_write(file,buf,len,&pos);
+}
+
+int sys_pread(unsigned int fd, struct iovec * iov, off_t pos)
+{
+	return do_prw(READ,fd,iov,pos);
+}
+
+int sys_pwrite(unsigned int fd, struct iovec * iov, off_t pos)
+{
+	return do_prw(WRITE,fd,iov,pos);
 }
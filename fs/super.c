@@ -20,18 +20,6 @@ int sync_dev(int dev);
 // 等待击键
 void wait_for_keypress(void);
 
-/* set_bit uses setb, as gas doesn't recognize setc */
-//// 测试指定位偏移处bit位的值，并返回该原bit位值。
-// 嵌入式汇编宏，参数bitnr是bit位偏移值，addr是测试bit位操作的起始地址。
-// %0 - ax(__res), %1 - 0, %2 - bitnr, %3 - addr, 下面一行定义了一个寄存器变量。
-// 该变量将被保存在eax寄存器中，以便于高效访问和操作，指令bt用于对bit位进行测试，它
-// 会把地址addr（%3）和bit位偏移量bitnr（%2）指定的bit位的值放入进位标志CF中，指令setb
-// 用于根据进位标志CF设置操作数%al.如果CF=1，则%al=1,否则%al=0.
-#define set_bit(bitnr,addr) ({ \
-register int __res ; \
-__asm__("bt %2,%3;setb %%al":"=a" (__res):"a" (0),"r" (bitnr),"m" (*(addr))); \
-__res; })
-
 // 超级块结构表数组（NR_SUPER = 8）
 struct super_block super_block[NR_SUPER];
 /* this is initialized in init/main.c */
@@ -109,8 +97,9 @@ void put_super(int dev)
 {
 	struct super_block * sb;
 	/* struct m_inode * inode;*/
-	int i;
 
+/* whatever happens below, the cached names on dev can't be trusted */
+	dcache_invalidate_dev(dev);
     // 首先判断参数的有效性和合法性。如果指定设备是根文件系统设备，则显示警告信息“根
     // 系统盘改变了，准备生死决战吧”，并返回。然后在超级块表现中寻找指定设备号的文件系统
     // 超级块。如果找不到指定设备的超级块，则返回。另外，如果该超级块指明该文件系统所安装
@@ -127,17 +116,10 @@ void put_super(int dev)
 		return;
 	}
     // 然后在找到指定设备的超级块之后，我们先锁定该超级块，再置该超级块对应的设备号字段
-    // s_dev为0，也即释放该设备上的文件系统超级块。然后释放该超级块占用的其他内核资源，
-    // 即释放该设备上文件系统i节点位图和逻辑块位图在缓冲区中所占用的缓冲块。下面常数符号
-    // I_MAP_SLOTS和Z_MAP_LOTS均等于8，用于分别指明i节点位图和逻辑块位图占用的磁盘逻辑块
-    // 数。注意，若这些缓冲块内荣被修改过，则需要作同步操作才能把缓冲块中的数据写入设备
-    // 中,函数最后对该超级块解锁，并返回。
+    // s_dev为0，也即释放该设备上的文件系统超级块。位图块只是普通的缓冲块，若被修改过，
+    // 则由随后的同步操作写入设备中。函数最后对该超级块解锁，并返回。
 	lock_super(sb);
 	sb->s_dev = 0;
-	for(i=0;i<I_MAP_SLOTS;i++)
-		brelse(sb->s_imap[i]);
-	for(i=0;i<Z_MAP_SLOTS;i++)
-		brelse(sb->s_zmap[i]);
 	free_super(sb);
 	return;
 }
@@ -149,7 +131,6 @@ static struct super_block * read_super(int dev)
 {
 	struct super_block * s;
 	struct buffer_head * bh;
-	int i,block;
 
     // 首先判断参数的有效性。如果没有指明设备，则返回空指针。然后检查该设备是否可更换过
     // 盘片（也即是否软盘设备）。如果更换盘片，则高速缓冲区有关设备的所有缓冲块均失效，
@@ -175,6 +156,7 @@ static struct super_block * read_super(int dev)
 	s->s_time = 0;
 	s->s_rd_only = 0;
 	s->s_dirt = 0;
+	s->s_flags = 0;
     // 然后锁定该超级块，并从设备上读取超级块信息到bh指向的缓冲块中。超级块位于设备的第
     // 2个逻辑块（1号块）中，（第1个是引导盘块）。如果读超级块操作失败，则释放上面选定
     // 的超级块数组中的项（即置s_dev=0），并解锁该项，返回空指针退出。否则就将设备上读取
@@ -193,48 +175,15 @@ static struct super_block * read_super(int dev)
     // 上读取i节点位图和逻辑块位图等信息。如果所读取的超级块的文件系统魔数字段不对，说明
     // 设备上不是正确的文件系统，因此同上面一样，释放上面选定的超级块数组中的项，并解锁该
     // 项，返回空指针退出。对于该版Linux内核，只支持MINIX文件系统1.0版本，其魔数是0x1371。
-	if (s->s_magic != SUPER_MAGIC) {
+	if (s->s_magic != SUPER_MAGIC || s->s_imap_blocks > I_MAP_SLOTS ||
+	    s->s_zmap_blocks > Z_MAP_SLOTS) {
 		s->s_dev = 0;
 		free_super(s);
 		return NULL;
 	}
-    // 下面开始读取设备上i节点的位图和逻辑块位图数据。首先初始化内存超级块结构中位图空间。
-    // 然后从设备上读取i节点位图和逻辑块位图信息，并存放在超级块对应字段中。i节点位图保存
-    // 在设备上2号块开始的逻辑块中，共占用s_imap_blocks个块，逻辑块位图在i节点位图所在块
-    // 的后续块中，共占用s_zmap_blocks个块。
-	for (i=0;i<I_MAP_SLOTS;i++)
-		s->s_imap[i] = NULL;
-	for (i=0;i<Z_MAP_SLOTS;i++)
-		s->s_zmap[i] = NULL;
-	block=2;
-	for (i=0 ; i < s->s_imap_blocks ; i++)
-		if ((s->s_imap[i]=bread(dev,block)))
-			block++;
-		else
-			break;
-	for (i=0 ; i < s->s_zmap_blocks ; i++)
-		if ((s->s_zmap[i]=bread(dev,block)))
-			block++;
-		else
-			break;
-    // 如果读出的位图块数不等于位图应该占有的逻辑块数，说明文件系统位图信息有问题，超级块
-    // 初始化是吧。因此只能释放前面申请并占用的所有资源，即释放i节点位图和逻辑块位图占用
-    // 的高速缓冲块、释放上面选定的超级块数组项、解锁该超级块项，并返回空指针退出。
-	if (block != 2+s->s_imap_blocks+s->s_zmap_blocks) {
-		for(i=0;i<I_MAP_SLOTS;i++)
-			brelse(s->s_imap[i]);
-		for(i=0;i<Z_MAP_SLOTS;i++)
-			brelse(s->s_zmap[i]);
-		s->s_dev=0;
-		free_super(s);
-		return NULL;
-	}
-    // 否则一切成功，另外，由于对申请空闲i节点的函数来讲，如果设备上所有的i节点已经全被使用
-    // 则查找函数会返回0值。因此0号i节点是不能用的，所以这里将位图中第1块的最低bit位设置为1，
-    // 以防止文件系统分配0号i节点。同样的道理，也将逻辑块位图的最低位设置为1.最后函数解锁该
-    // 超级块，并放回超级块指针。
-	s->s_imap[0]->b_data[0] |= 1;
-	s->s_zmap[0]->b_data[0] |= 1;
+    // 位图块并不在这里读入，而是在分配或释放时才通过高速缓冲读取(见bitmap.c)。
+    // 因此这里只需复位空闲计数，安装操作的时间与设备大小无关。
+	init_free_counts(s);
 	free_super(s);
 	return s;
 }
@@ -273,9 +222,8 @@ int sys_umount(char * dev_name)
 		return -ENOENT;
 	if (!sb->s_imount->i_mount)
 		printk("Mounted inode has i_mount=0\n");
-	for (inode=inode_table+0 ; inode<inode_table+NR_INODE ; inode++)
-		if (inode->i_dev==dev && inode->i_count)
-				return -EBUSY;
+	if (!fs_may_umount(dev))
+		return -EBUSY;
     // 现在该设备上文件系统的卸载条件均得到满足，因此我们可以开始实施真正的卸载操作了。
     // 首先复位被安装到的i节点的安装标志，释放该i节点。然后置超级块中被安装i节点字段为
     // 空，并放回设备文件系统的根i节点。接着置超级块中被安装系统根i节点指针为空。
@@ -349,8 +297,9 @@ int sys_mount(char * dev_name, char * dir_name, int rw_flag)
     // 最后设置被安装文件系统超级块的“被安装到i节点”字段指向安装到的目录名的i节点。并设置
     // 安装位置i节点的安装标志和节点已修改标志。然后返回（安装成功）。
 	sb->s_imount=dir_i;
+	sb->s_flags = rw_flag & (MS_NOATIME | MS_RELATIME);
 	dir_i->i_mount=1;
-	dir_i->i_dirt=1;		/* NOTE! we don't iput(dir_i) */
+	mark_inode_dirty(dir_i);		/* NOTE! we don't iput(dir_i) */
 	return 0;			/* we do that in umount */
 }
 
@@ -360,7 +309,7 @@ int sys_mount(char * dev_name, char * dir_name, int rw_flag)
 // （空闲块数和空闲i节点数）。该函数会在系统开机进行初始化设置时被调用。
 void mount_root(void)
 {
-	int i,free;
+	int i;
 	struct super_block * p;
 	struct m_inode * mi;
 
@@ -373,6 +322,8 @@ void mount_root(void)
     // 并等待按键。
 	for(i=0;i<NR_FILE;i++)
 		file_table[i].f_count=0;                        // 初始化文件表
+	dcache_init();
+	inode_init();
 	if (MAJOR(ROOT_DEV) == 2) {
 		printk("Insert root floppy and press ENTER");   // 提示插入根文件系统盘
 		wait_for_keypress();
@@ -396,23 +347,9 @@ void mount_root(void)
 	p->s_isup = p->s_imount = mi;
 	current->pwd = mi;
 	current->root = mi;
-    // 然后我们对根文件系统的资源作统计工作。统计该设备上空闲块数和空闲i节点数。首先令i等于
-    // 超级块中表明的设备逻辑块总数。然后根据逻辑块相应bit位的占用情况统计出空闲块数。这里
-    // 宏函数set_bit()只是在测试bit位，而非设置bit位。“i&8191”用于取得i节点号在当前位图块中对应
-    // 的bit位偏移值。"i>>13"是将i除以8192，也即除一个磁盘块包含的bit位数。
-	free=0;
-	i=p->s_nzones;
-	while (-- i >= 0)
-		if (!set_bit(i&8191,p->s_zmap[i>>13]->b_data))
-			free++;
-    // 在显示过设备上空闲逻辑块数/逻辑块总数之后。我们再统计设备上空闲i节点数。首先令i等于超级块
-    // 中表明的设备上i节点总数+1.加1是将0节点也统计进去，然后根据i节点位图相应bit位的占用情况计算
-    // 出空闲i节点数。最后再显示设备上可用空闲i节点数和i节点总数
-	printk("%d/%d free blocks\n\r",free,p->s_nzones);
-	free=0;
-	i=p->s_ninodes+1;
-	while (-- i >= 0)
-		if (!set_bit(i&8191,p->s_imap[i>>13]->b_data))
-			free++;
-	printk("%d/%d free inodes\n\r",free,p->s_ninodes);
+    // 最后显示根文件系统的空闲块数和空闲i节点数。为此需要先统计所有的位图块。
+	count_map(p,1,~0UL);
+	count_map(p,0,~0UL);
+	printk("%d/%d free blocks\n\r",p->s_free_zones,p->s_nzones);
+	printk("%d/%d free inodes\n\r",p->s_free_inodes,p->s_ninodes);
 }
@@ -38,16 +38,26 @@ static void free_dind(int dev,int block)
 {
 	struct buffer_head * bh;
 	unsigned short * p;
-	int i;
+	int i, n, ahead = 0;
 
 	if (!block)
 		return;
     // 读取二次间接块的一级块，并释放其上表明使用的所有的逻辑块，然后释放该一级块的缓冲区
 	if ((bh=bread(dev,block))) {
 		p = (unsigned short *) bh->b_data;
-		for (i=0;i<512;i++,p++)
-			if (*p)
-				free_ind(dev,*p);       // 释放所有一次间接块
+		for (i=0;i<512;i++,p++) {
+			if (!*p)
+				continue;
+/* read the indirect blocks that follow each other on disk in one go */
+			if (i >= ahead) {
+				for (n=1 ; i+n<512 && p[n]==p[0]+n ; n++)
+					/* nothing */ ;
+				if (n > 1)
+					brelse(bread_cluster(dev,*p,n));
+				ahead = i+n;
+			}
+			free_ind(dev,*p);       // 释放所有一次间接块
+		}
         // 释放二次间接块占用的缓冲块
 		brelse(bh);
 	}
@@ -61,6 +71,9 @@ void truncate(struct m_inode * inode)
 {
 	int i;
 
+	discard_delayed(inode);
+	discard_prealloc(inode);
+	inode->i_ext_len = 0;
     // 首先判断指定i节点的有效性，如果不是常规文件或者是目录文件，则返回
 	if (!(S_ISREG(inode->i_mode) || S_ISDIR(inode->i_mode)))
 		return;
@@ -74,7 +87,7 @@ void truncate(struct m_inode * inode)
 	free_dind(inode->i_dev,inode->i_zone[8]);           // 释放所有二次间接块
 	inode->i_zone[7] = inode->i_zone[8] = 0;            // 逻辑块项7、8置零
 	inode->i_size = 0;                                  // 文件大小置零
-	inode->i_dirt = 1;                                  // 置节点已修改标志
+	mark_inode_dirty(inode);                            // 置节点已修改标志
     // 最后重置文件修改时间和i节点改变时间为当前时间。宏CURRENT_TIME定义在
     // include/linux/sched.h中，用于取得从1970:0:0:0开始到现在为止经过的秒数。
 	inode->i_mtime = inode->i_ctime = CURRENT_TIME;
@@ -2,7 +2,7 @@ static inline unsigned char get_fs_byte(const char * addr)
 {
 	unsigned register char _v;
 
-	__asm__ ("movb %%fs:%1,%0":"=r" (_v):"m" (*addr));
+	__asm__ __volatile__ ("movb %%fs:%1,%0":"=r" (_v):"m" (*addr));
 	return _v;
 }
 
@@ -37,6 +37,100 @@ static inline void put_fs_long(unsigned long val,unsigned long * addr)
 __asm__ ("movl %0,%%fs:%1"::"r" (val),"m" (*addr));
 }
 
+/*
+ * Bulk copies between the kernel and the user segment (fs). Bytes and a
+ * word are moved until the destination is long aligned, the bulk goes a
+ * long at a time, and the odd bytes at the end one by one. Copies of
+ * less than 4 bytes just go byte by byte. copy_to_user() has to point
+ * es at the user segment, as movs always stores through es.
+ */
+static inline void copy_to_user(char * to, const char * from, unsigned long n)
+{
+	int d0, d1, d2, d3;
+
+__asm__ __volatile__ ("cld\n\t"
+	"push %%es\n\t"
+	"push %%fs\n\t"
+	"pop %%es\n\t"
+	"cmpl $4,%%ecx\n\t"
+	"jb 3f\n\t"
+	"testl $1,%%edi\n\t"
+	"je 1f\n\t"
+	"movsb\n\t"
+	"decl %%ecx\n"
+	"1:\ttestl $2,%%edi\n\t"
+	"je 2f\n\t"
+	"movsw\n\t"
+	"subl $2,%%ecx\n"
+	"2:\tmovl %%ecx,%%eax\n\t"
+	"shrl $2,%%ecx\n\t"
+	"rep ; movsl\n\t"
+	"movl %%eax,%%ecx\n\t"
+	"andl $3,%%ecx\n"
+	"3:\trep ; movsb\n\t"
+	"pop %%es"
+	:"=&c" (d0),"=&D" (d1),"=&S" (d2),"=&a" (d3)
+	:"0" (n),"1" ((long) to),"2" ((long) from)
+	:"memory");
+}
+
+static inline void copy_from_user(char * to, const char * from,
+	unsigned long n)
+{
+	int d0, d1, d2, d3;
+
+__asm__ __volatile__ ("cld\n\t"
+	"cmpl $4,%%ecx\n\t"
+	"jb 3f\n\t"
+	"testl $1,%%edi\n\t"
+	"je 1f\n\t"
+	"fs ; movsb\n\t"
+	"decl %%ecx\n"
+	"1:\ttestl $2,%%edi\n\t"
+	"je 2f\n\t"
+	"fs ; movsw\n\t"
+	"subl $2,%%ecx\n"
+	"2:\tmovl %%ecx,%%eax\n\t"
+	"shrl $2,%%ecx\n\t"
+	"rep ; fs ; movsl\n\t"
+	"movl %%eax,%%ecx\n\t"
+	"andl $3,%%ecx\n"
+	"3:\trep ; fs ; movsb"
+	:"=&c" (d0),"=&D" (d1),"=&S" (d2),"=&a" (d3)
+	:"0" (n),"1" ((long) to),"2" ((long) from)
+	:"memory");
+}
+
+static inline void clear_user(char * to, unsigned long n)
+{
+	int d0, d1, d2;
+
+__asm__ __volatile__ ("cld\n\t"
+	"push %%es\n\t"
+	"push %%fs\n\t"
+	"pop %%es\n\t"
+	"cmpl $4,%%ecx\n\t"
+	"jb 3f\n\t"
+	"testl $1,%%edi\n\t"
+	"je 1f\n\t"
+	"stosb\n\t"
+	"decl %%ecx\n"
+	"1:\ttestl $2,%%edi\n\t"
+	"je 2f\n\t"
+	"stosw\n\t"
+	"subl $2,%%ecx\n"
+	"2:\tmovl %%ecx,%%edx\n\t"
+	"shrl $2,%%ecx\n\t"
+	"rep ; stosl\n\t"
+	"movl %%edx,%%ecx\n\t"
+	"andl $3,%%ecx\n"
+	"3:\trep ; stosb\n\t"
+	"pop %%es"
+	:"=&c" (d0),"=&D" (d1),"=&d" (d2)
+	:"0" (n),"1" ((long) to),"a" (0)
+	:"memory");
+}
+
 /*
  * Someone who knows GNU asm better than I should double check the followig.
  * It seems to work, but I don't know if I'm doing something subtly wrong.
@@ -15,6 +15,7 @@
 #define O_APPEND	02000
 #define O_NONBLOCK	04000	/* not fcntl */
 #define O_NDELAY	O_NONBLOCK
+#define O_DIRECT	040000	/* bypass the buffer cache */
 
 /* Defines for fcntl-commands. Note that currently
  * locking isn't supported, and other things aren't really
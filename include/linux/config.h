@@ -45,4 +45,22 @@
  leave HD_TYPE undefined. This is the normal thing to do.
 */
 
+/*
+ * The harddisk driver uses bus-master DMA if it finds a PIIX-style
+ * IDE controller and the drive says it can do DMA, else it moves the
+ * data itself. Define HD_NO_DMA if you always want the latter.
+ */
+/* #define HD_NO_DMA */
+
+/*
+ * Block devices have a request scheduler each. They use the elevator
+ * unless their major number has a bit set in BLK_DEADLINE, in which
+ * case they get the deadline scheduler, that doesn't let reads wait
+ * behind long streams of writes. Default is deadline for the harddisk.
+ * This is only the default: the word at offset 506 of the boot sector
+ * (see boot/bootsect.s and tools/build) overrides it, as root_dev does
+ * the root device, unless it is left at 0xffff.
+ */
+#define BLK_DEADLINE	(1<<3)
+
 #endif
@@ -30,6 +30,10 @@
 
 void buffer_init(long buffer_end);
 
+/* mount flags, the third argument of mount() */
+#define MS_NOATIME	1	/* don't update access times */
+#define MS_RELATIME	2	/* ... unless older than mtime/ctime or a day */
+
 #define MAJOR(a) (((unsigned)(a))>>8)
 #define MINOR(a) ((a)&0xff)
 
@@ -44,7 +48,9 @@ void buffer_init(long buffer_end);
 #define NR_INODE 32
 #define NR_FILE 64
 #define NR_SUPER 8
-#define NR_HASH 307
+#define MIN_READAHEAD 4
+#define MAX_READAHEAD 32
+#define NR_PREALLOC 8
 #define NR_BUFFERS nr_buffers
 #define BLOCK_SIZE 1024
 #define BLOCK_SIZE_BITS 10
@@ -78,6 +84,19 @@ struct buffer_head {
 	struct buffer_head * b_next;
 	struct buffer_head * b_prev_free;
 	struct buffer_head * b_next_free;
+	struct buffer_head * b_reqnext;		/* next buffer in request */
+	unsigned long b_dirtime;	/* jiffies when it became dirty */
+	unsigned char b_list;		/* 2Q list: 0 - A1in, 1 - Am */
+	unsigned char b_parked;		/* off its list: held or dirty */
+	struct buffer_head * b_this_page;	/* buffers of the same page */
+	struct buffer_head * b_next_all;	/* list of all buffers */
+	struct buffer_head * b_prev_all;
+	unsigned char b_delay;		/* no zone yet: zones reserved for it */
+	struct buffer_head * b_next_delay;	/* next one of the same inode */
+	struct buffer_head * b_next_dev;	/* buffers of the same device */
+	struct buffer_head * b_prev_dev;
+	struct buffer_head * b_next_dirty;	/* ... and the dirty ones */
+	struct buffer_head * b_prev_dirty;
 };
 
 struct d_inode {
@@ -111,6 +130,23 @@ struct m_inode {
 	unsigned char i_mount;
 	unsigned char i_seek;
 	unsigned char i_update;
+	unsigned short i_pblock;	/* first preallocated zone */
+	unsigned short i_pcount;	/* number of preallocated zones */
+	unsigned long i_ext_lblock;	/* last extent mapped: file block, */
+	unsigned short i_ext_pblock;	/* zone ... */
+	unsigned short i_ext_len;	/* ... and length, 0 - none */
+	struct buffer_head * i_delay;	/* delayed blocks, in block order */
+	struct buffer_head * i_dlast;
+	unsigned long i_delaytime;	/* jiffies when the first was delayed */
+	unsigned short i_goal;		/* zone a new file starts near */
+/* list pointers, kept by clear_inode(): these have to come last */
+	struct m_inode * i_next;	/* hash chain */
+	struct m_inode * i_prev;
+	struct m_inode * i_next_free;	/* unused list, i_count == 0 */
+	struct m_inode * i_prev_free;
+	struct m_inode * i_next_all;	/* list of all inodes */
+	struct m_inode * i_next_dirty;	/* dirty list, i_dirt set */
+	struct m_inode * i_prev_dirty;
 };
 
 struct file {
@@ -119,6 +155,10 @@ struct file {
 	unsigned short f_count;
 	struct m_inode * f_inode;
 	off_t f_pos;
+/* readahead state, in blocks: see file_read() */
+	unsigned long f_ranext;		/* where a sequential read would start */
+	unsigned long f_raend;		/* readahead issued up to here */
+	unsigned long f_rawin;		/* window size, 0 - no readahead */
 };
 
 struct super_block {
@@ -131,8 +171,6 @@ struct super_block {
 	unsigned long s_max_size;
 	unsigned short s_magic;
 /* These are only in memory */
-	struct buffer_head * s_imap[8];
-	struct buffer_head * s_zmap[8];
 	unsigned short s_dev;
 	struct m_inode * s_isup;
 	struct m_inode * s_imount;
@@ -141,6 +179,18 @@ struct super_block {
 	unsigned char s_lock;
 	unsigned char s_rd_only;
 	unsigned char s_dirt;
+	unsigned short s_flags;		/* MS_NOATIME, MS_RELATIME */
+/* free-space summaries, kept up to date by bitmap.c: the maps themselves */
+/* are read through the buffer cache when needed */
+	unsigned short s_zfree[Z_MAP_SLOTS];	/* free bits in each zmap block */
+	unsigned short s_ifree[I_MAP_SLOTS];	/* ... and imap block */
+	unsigned long s_free_zones;
+	unsigned long s_free_inodes;
+	unsigned long s_reserved;	/* zones promised to delayed blocks */
+	unsigned char s_zlast;		/* map blocks last allocated from */
+	unsigned char s_ilast;
+	unsigned char s_zcounted;	/* map blocks counted so far, */
+	unsigned char s_icounted;	/* one bit each */
 };
 
 struct d_super_block {
@@ -159,11 +209,11 @@ struct dir_entry {
 	char name[NAME_LEN];
 };
 
-extern struct m_inode inode_table[NR_INODE];
 extern struct file file_table[NR_FILE];
 extern struct super_block super_block[NR_SUPER];
 extern struct buffer_head * start_buffer;
 extern int nr_buffers;
+extern int nr_buffers_dirty;
 
 extern void check_disk_change(int dev);
 extern int floppy_change(unsigned int nr);
@@ -174,27 +224,61 @@ extern void truncate(struct m_inode * inode);
 extern void sync_inodes(void);
 extern void wait_on(struct m_inode * inode);
 extern int bmap(struct m_inode * inode,int block);
+extern int bmap_nodelay(struct m_inode * inode,int block);
 extern int create_block(struct m_inode * inode,int block);
+extern struct buffer_head * delayed_block(struct m_inode * inode,
+	int block, int create);
+extern void release_delayed(struct buffer_head * bh);
+extern int commit_delayed(struct m_inode * inode);
+extern void discard_delayed(struct m_inode * inode);
+extern void sync_delayed(long age);
 extern struct m_inode * namei(const char * pathname);
 extern int open_namei(const char * pathname, int flag, int mode,
 	struct m_inode ** res_inode);
 extern void iput(struct m_inode * inode);
+extern void update_atime(struct m_inode * inode, int dirty);
+extern void mark_inode_dirty(struct m_inode * inode);
 extern struct m_inode * iget(int dev,int nr);
 extern struct m_inode * get_empty_inode(void);
 extern struct m_inode * get_pipe_inode(void);
+extern void inode_init(void);
+extern void insert_inode_hash(struct m_inode * inode);
+extern void clear_inode(struct m_inode * inode);
+extern int fs_may_umount(int dev);
 extern struct buffer_head * get_hash_table(int dev, int block);
 extern struct buffer_head * getblk(int dev, int block);
+extern struct buffer_head * get_delay_buffer(void);
 extern void ll_rw_block(int rw, struct buffer_head * bh);
+extern void ll_rw_blocks(int rw, int nr, struct buffer_head * bh[]);
+extern void ll_rw_direct(int rw, int nr, struct buffer_head * bh[]);
 extern void brelse(struct buffer_head * buf);
+extern void put_buffer(struct buffer_head * bh);
+extern void mark_buffer_dirty(struct buffer_head * bh);
+extern void clear_buffer_dirty(struct buffer_head * bh);
 extern struct buffer_head * bread(int dev,int block);
 extern void bread_page(unsigned long addr,int dev,int b[4]);
 extern struct buffer_head * breada(int dev,int block,...);
-extern int new_block(int dev);
+extern struct buffer_head * bread_cluster(int dev,int block,int nr);
+extern int direct_io(int rw, int dev, int block, int nr, char * buf);
+extern int new_block(int dev, int goal);
+extern void zero_block(int dev, int block);
+extern int prealloc_blocks(int dev, int block, int count);
+extern void discard_prealloc(struct m_inode * inode);
 extern void free_block(int dev, int block);
 extern struct m_inode * new_inode(int dev);
 extern void free_inode(struct m_inode * inode);
+extern void init_free_counts(struct super_block * sb);
+extern unsigned long count_map(struct super_block * sb, int zmap,
+	unsigned long want);
 extern int sync_dev(int dev);
 extern struct super_block * get_super(int dev);
+extern unsigned long dcache_seq;
+extern void dcache_init(void);
+extern int dcache_lookup(int dev, int dir, const char * name, int len, int * ino);
+extern void dcache_add(int dev, int dir, const char * name, int len, int ino);
+extern void dcache_invalidate(int dev, int dir, const char * name, int len);
+extern void dcache_invalidate_dir(int dev, int dir);
+extern void dcache_invalidate_dev(int dev);
 extern int ROOT_DEV;
 
 extern void mount_root(void);
@@ -40,6 +40,27 @@
 #define WIN_SEEK 		0x70
 #define WIN_DIAGNOSE		0x90
 #define WIN_SPECIFY		0x91
+#define WIN_MULTREAD		0xC4	/* read sectors using multiple mode */
+#define WIN_MULTWRITE		0xC5	/* write sectors using multiple mode */
+#define WIN_SETMULT		0xC6	/* enable read/write multiple mode */
+#define WIN_IDENTIFY		0xEC	/* ask drive to identify itself */
+#define WIN_READDMA		0xC8	/* read sectors using bus-master DMA */
+#define WIN_WRITEDMA		0xCA	/* write sectors using bus-master DMA */
+
+/* Bus-master IDE registers, offsets from the base in PCI BAR4 */
+#define BM_COMMAND	0	/* bit 0 start, bit 3 write to memory */
+#define BM_STATUS	2	/* see bm-status bits */
+#define BM_PRD		4	/* physical address of PRD table */
+
+/* Bits of BM_COMMAND */
+#define BM_START	0x01
+#define BM_READ		0x08	/* device to memory, ie a disk read */
+
+/* Bits of BM_STATUS */
+#define BM_ACTIVE	0x01
+#define BM_ERR		0x02
+#define BM_INTR		0x04
+#define BM_CAPABLE	0x60	/* drive 0/1 can do DMA: set by the BIOS */
 
 /* Bits for HD_ERROR */
 #define MARK_ERR	0x01	/* Bad address mark ? */
@@ -6,5 +6,6 @@
 extern unsigned long get_free_page(void);
 extern unsigned long put_page(unsigned long page,unsigned long address);
 extern void free_page(unsigned long addr);
+extern unsigned long user_page(unsigned long addr, int write);
 
 #endif
@@ -0,0 +1,35 @@
+#ifndef _SYS_IOSTAT_H
+#define _SYS_IOSTAT_H
+
+/*
+ * Block-I/O statistics, as returned by iostat(). These are simple
+ * event counters since boot: they wrap, and nobody resets them.
+ */
+struct iostat {
+	unsigned long hd_intr;		/* hd read/write data interrupts */
+	unsigned long hd_sectors;	/* sectors moved by those interrupts */
+	unsigned long bd_wakeups;	/* times the flusher ran */
+	unsigned long bd_written;	/* buffers it queued for writing */
+	unsigned long bd_syncwrites;	/* getblk() had to write out itself */
+	unsigned long bc_hits;		/* getblk() found the block cached */
+	unsigned long bc_misses;	/* ... or had to take a new buffer */
+	unsigned long bc_evictions;	/* which held some other block */
+	unsigned long bc_ghosthits;	/* misses on blocks still in A1out */
+	unsigned long bc_grown;		/* pages added to the buffer cache */
+	unsigned long bc_shrunk;	/* pages given back */
+	unsigned long hash_buckets;	/* size of the buffer hash table */
+	unsigned long hash_lookups;	/* buffer hash lookups ... */
+	unsigned long hash_probes;	/* ... and chain entries looked at */
+	unsigned long hash_maxchain;	/* longest chain walked in a lookup */
+	unsigned long dc_hits;		/* names found in the directory cache */
+	unsigned long dc_misses;	/* ... or looked up in the directory */
+	unsigned long atime_skipped;	/* atime updates left out (noatime, */
+					/* relatime): inode writes saved */
+	unsigned long direct_blocks;	/* blocks read or written O_DIRECT */
+	unsigned long hd_dma;		/* hd transfers done with DMA ... */
+	unsigned long hd_dma_errors;	/* ... and ones that fell back to PIO */
+};
+
+extern int iostat(struct iostat * buf);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef _SYS_UIO_H
+#define _SYS_UIO_H
+
+#include <sys/types.h>
+
+struct iovec {
+	void * iov_base;	/* start of the buffer */
+	int iov_len;		/* ... and its length */
+};
+
+extern int readv(int fildes, const struct iovec * iov, int iovcnt);
+extern int writev(int fildes, const struct iovec * iov, int iovcnt);
+
+#endif
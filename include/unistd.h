@@ -53,6 +53,7 @@
 #include <sys/stat.h>
 #include <sys/times.h>
 #include <sys/utsname.h>
+#include <sys/iostat.h>
 #include <utime.h>
 
 #ifdef __LIBRARY__
@@ -129,6 +130,12 @@
 #define __NR_ssetmask	69
 #define __NR_setreuid	70
 #define __NR_setregid	71
+#define __NR_iostat	72
+#define __NR_bdflush	73
+#define __NR_readv	74
+#define __NR_writev	75
+#define __NR_pread	76	/* (fd, struct iovec *, pos) */
+#define __NR_pwrite	77
 
 #define _syscall0(type,name) \
 type name(void) \
@@ -249,5 +256,9 @@ int dup2(int oldfd, int newfd);
 int getppid(void);
 pid_t getpgrp(void);
 pid_t setsid(void);
+int iostat(struct iostat * buf);
+int bdflush(int func, long data);
+int pread(int fildes, char * buf, int count, off_t offset);
+int pwrite(int fildes, const char * buf, int count, off_t offset);
 
 #endif
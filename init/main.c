@@ -45,6 +45,7 @@ static inline _syscall0(int,pause)
 static inline _syscall1(int,setup,void *,BIOS)
 // int sync()系统调用：更新文件系统。
 static inline _syscall0(int,sync)
+static inline _syscall2(int,bdflush,int,func,long,data)
 
 // tty头文件，定义了有关tty_io, 串行通信方面的参数、常数
 #include <linux/tty.h>
@@ -72,6 +73,7 @@ static char printbuf[1024];
 extern int vsprintf();
 extern void init(void);
 extern void blk_dev_init(void);
+extern int blk_deadline;
 extern void chr_dev_init(void);
 extern void hd_init(void);
 extern void floppy_init(void);
@@ -90,6 +92,7 @@ extern long startup_time;       // 内核启动时间（开机时间）（秒）
 #define EXT_MEM_K (*(unsigned short *)0x90002)
 #define DRIVE_INFO (*(struct drive_info *)0x90080)
 #define ORIG_ROOT_DEV (*(unsigned short *)0x901FC)
+#define ORIG_BLK_SCHED (*(unsigned short *)0x901FA)
 
 /*
  * Yeah, yeah, it's ugly, but I cannot find how to do this correctly
@@ -155,17 +158,15 @@ void main(void)		/* This really IS void, no error here. */
     // 机器内存数->memory_end；主内存开始地址->main_memory_start；
     // 其中ROOT_DEV已在前面包含进的fs.h文件中声明为extern int
  	ROOT_DEV = ORIG_ROOT_DEV;
+	if (ORIG_BLK_SCHED != 0xffff)
+		blk_deadline = ORIG_BLK_SCHED;
  	drive_info = DRIVE_INFO;        // 复制0x90080处的硬盘参数
 	memory_end = (1<<20) + (EXT_MEM_K<<10);     // 内存大小=1Mb + 扩展内存(k)*1024 byte
 	memory_end &= 0xfffff000;                   // 忽略不到4kb(1页)的内存数
 	if (memory_end > 16*1024*1024)              // 内存超过16Mb，则按16Mb计
 		memory_end = 16*1024*1024;
-	if (memory_end > 12*1024*1024)              // 如果内存>12Mb,则设置缓冲区末端=4Mb 
-		buffer_memory_end = 4*1024*1024;
-	else if (memory_end > 6*1024*1024)          // 否则若内存>6Mb,则设置缓冲区末端=2Mb
-		buffer_memory_end = 2*1024*1024;
-	else
-		buffer_memory_end = 1*1024*1024;        // 否则设置缓冲区末端=1Mb
+/* only the low 1Mb is set aside: the buffer cache grows from free pages */
+	buffer_memory_end = 1*1024*1024;
 	main_memory_start = buffer_memory_end;
     // 如果在Makefile文件中定义了内存虚拟盘符号RAMDISK,则初始化虚拟盘。此时主内存将减少。
 #ifdef RAMDISK
@@ -238,6 +239,9 @@ void init(void)
     // 和安装根文件系统设备。该函数用25行上的宏定义，对应函数是sys_setup()，在块设备
     // 子目录kernel/blk_drv/hd.c中。
 	setup((void *) &drive_info);        // drive_info结构是2个硬盘参数表
+/* the buffer flusher lives in the kernel: this child never returns */
+	if (!fork())
+		_exit(bdflush(0,0));
     // 下面以读写访问方式打开设备"/dev/tty0",它对应终端控制台。由于这是第一次打开文件
     // 操作，因此产生的文件句柄号(文件描述符)肯定是0。该句柄是UNIX类操作系统默认的
     // 控制台标准输入句柄stdin。这里再把它以读和写的方式别人打开是为了复制产生标准输出(写)
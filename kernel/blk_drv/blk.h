@@ -14,11 +14,24 @@
  */
 #define NR_REQUEST	32
 
+/*
+ * Buffers that are adjacent on disk are merged into one request (see
+ * make_request()), but only up to MAX_SECTORS. The AT-controller can't
+ * take more than 255 sectors in one command anyway, and we don't want
+ * to lock the drive up with one request for too long.
+ */
+#define MAX_SECTORS	128
+
 /*
  * Ok, this is an expanded form so that we can use the same
  * request for paging requests when that is implemented. In
  * paging, 'bh' is NULL, and 'waiting' is used to wait for
  * read/write completion.
+ *
+ * A request may cover several buffers, chained through b_reqnext
+ * from 'bh' to 'bhtail'. 'buffer' and 'current_nr_sectors' always
+ * describe the part of the first buffer that is still to be done,
+ * 'sector' and 'nr_sectors' the whole remaining request.
  */
 struct request {
 	int dev;		/* -1 if no request */
@@ -26,10 +39,14 @@ struct request {
 	int errors;
 	unsigned long sector;
 	unsigned long nr_sectors;
+	unsigned long current_nr_sectors;
 	char * buffer;
 	struct task_struct * waiting;
 	struct buffer_head * bh;
+	struct buffer_head * bhtail;
 	struct request * next;
+	struct request * fifo_next;	/* used by the deadline scheduler */
+	unsigned long expires;
 };
 
 /*
@@ -42,14 +59,50 @@ struct request {
 ((s1)->dev < (s2)->dev || ((s1)->dev == (s2)->dev && \
 (s1)->sector < (s2)->sector))))
 
+/*
+ * Requests that are not yet being worked on are kept by the request
+ * scheduler of the device: add() queues a request, next() takes out
+ * the one the driver should do next, or returns NULL if there is none.
+ * Both are called with interrupts off.
+ */
+struct blk_dev_struct;
+
+struct blk_sched {
+	char * name;
+	void (*add)(struct blk_dev_struct * dev, struct request * req);
+	struct request * (*next)(struct blk_dev_struct * dev);
+};
+
 struct blk_dev_struct {
 	void (*request_fn)(void);
 	struct request * current_request;
+	struct blk_sched * sched;
+/* these are for the scheduler: queue[0] is the elevator's only list */
+	struct request * queue[2];	/* pending, sorted, per direction */
+	struct request * fifo[2];	/* pending, oldest first */
+	int last_dev;
+	unsigned long last_sector;
+	int dir;
+	int batch;
+	int starved;
 };
 
+/*
+ * Deadline scheduler tunables. A read should be started within half
+ * a second, a write within 5. Up to DL_BATCH requests are done in a
+ * row in one direction, and pending writes are passed over for reads
+ * at most DL_STARVED times.
+ */
+#define DL_READ_EXPIRE	(HZ/2)
+#define DL_WRITE_EXPIRE	(5*HZ)
+#define DL_BATCH	16
+#define DL_STARVED	2
+
 extern struct blk_dev_struct blk_dev[NR_BLK_DEV];
 extern struct request request[NR_REQUEST];
 extern struct task_struct * wait_for_request;
+extern struct blk_sched elevator_sched;
+extern struct blk_sched deadline_sched;
 
 #ifdef MAJOR_NR
 
@@ -106,22 +159,44 @@ static inline void unlock_buffer(struct buffer_head * bh)
 	wake_up(&bh->b_wait);
 }
 
+/*
+ * end_request() finishes the first buffer of the current request. If
+ * the request was merged and has more buffers, it stays current and
+ * 'buffer' is set up for the next one, so the drivers should look at
+ * nr_sectors to find out if they are done with it. A failed buffer is
+ * skipped, the rest of the request is still tried.
+ */
 static inline void end_request(int uptodate)
 {
-	DEVICE_OFF(CURRENT->dev);
-	if (CURRENT->bh) {
-		CURRENT->bh->b_uptodate = uptodate;
-		unlock_buffer(CURRENT->bh);
-	}
+	struct buffer_head * bh;
+
 	if (!uptodate) {
 		printk(DEVICE_NAME " I/O error\n\r");
-		printk("dev %04x, block %d\n\r",CURRENT->dev,
-			CURRENT->bh->b_blocknr);
+		printk("dev %04x, sector %d\n\r",CURRENT->dev,
+			CURRENT->sector);
+		if (CURRENT->nr_sectors > CURRENT->current_nr_sectors) {
+			CURRENT->sector += CURRENT->current_nr_sectors;
+			CURRENT->nr_sectors -= CURRENT->current_nr_sectors;
+		} else
+			CURRENT->nr_sectors = 0;
 	}
+	if ((bh = CURRENT->bh)) {
+		CURRENT->bh = bh->b_reqnext;
+		bh->b_reqnext = NULL;
+		bh->b_uptodate = uptodate;
+		unlock_buffer(bh);
+		if ((bh = CURRENT->bh)) {
+			CURRENT->buffer = bh->b_data;
+			CURRENT->current_nr_sectors = BLOCK_SIZE>>9;
+			CURRENT->errors = 0;
+			return;
+		}
+	}
+	DEVICE_OFF(CURRENT->dev);
 	wake_up(&CURRENT->waiting);
 	wake_up(&wait_for_request);
 	CURRENT->dev = -1;
-	CURRENT = CURRENT->next;
+	CURRENT = (blk_dev[MAJOR_NR].sched->next)(blk_dev+MAJOR_NR);
 }
 
 #define INIT_REQUEST \
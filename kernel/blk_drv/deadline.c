@@ -0,0 +1,108 @@
+/*
+ *  linux/kernel/blk_drv/deadline.c
+ *
+ * (C) 1991 Linus Torvalds
+ */
+
+/*
+ * The deadline request scheduler. Pending requests are kept twice for
+ * each direction: sorted on disk, and in the order they came in. The
+ * sorted lists are normally worked through in batches, but when the
+ * oldest request of a direction has waited too long, the next batch
+ * starts with it. Reads are preferred, but writes can't be passed over
+ * more than DL_STARVED times in a row.
+ */
+#include <linux/sched.h>
+#include <linux/kernel.h>
+
+#include "blk.h"
+
+#define BEFORE(d,s,r) \
+((d) < (r)->dev || ((d) == (r)->dev && (s) <= (r)->sector))
+
+static void deadline_add(struct blk_dev_struct * dev, struct request * req)
+{
+	struct request ** p;
+	int dir = req->cmd;
+
+	for (p = &dev->queue[dir] ; *p ; p = &(*p)->next)
+		if (BEFORE(req->dev,req->sector,*p))
+			break;
+	req->next = *p;
+	*p = req;
+	for (p = &dev->fifo[dir] ; *p ; p = &(*p)->fifo_next)
+		/* nothing */ ;
+	req->fifo_next = NULL;
+	*p = req;
+	req->expires = jiffies +
+		((dir == READ)?DL_READ_EXPIRE:DL_WRITE_EXPIRE);
+}
+
+/*
+ * next_sorted() gives the first request of the sorted list that is at
+ * or after the place on disk where the last one ended.
+ */
+static struct request * next_sorted(struct blk_dev_struct * dev, int dir)
+{
+	struct request * req;
+
+	for (req = dev->queue[dir] ; req ; req = req->next)
+		if (BEFORE(dev->last_dev,dev->last_sector,req))
+			break;
+	return req;
+}
+
+static void unlink_request(struct blk_dev_struct * dev, struct request * req)
+{
+	struct request ** p;
+
+	for (p = &dev->queue[req->cmd] ; *p ; p = &(*p)->next)
+		if (*p == req) {
+			*p = req->next;
+			break;
+		}
+	for (p = &dev->fifo[req->cmd] ; *p ; p = &(*p)->fifo_next)
+		if (*p == req) {
+			*p = req->fifo_next;
+			break;
+		}
+	req->next = NULL;
+	req->fifo_next = NULL;
+}
+
+static struct request * deadline_next(struct blk_dev_struct * dev)
+{
+	struct request * req;
+	int dir = dev->dir;
+
+	if (dev->batch < DL_BATCH && (req = next_sorted(dev,dir)))
+		goto dispatch;
+	if (dev->queue[READ]) {
+		if (dev->queue[WRITE] && dev->starved++ >= DL_STARVED)
+			goto writes;
+		dir = READ;
+	} else if (dev->queue[WRITE]) {
+writes:
+		dev->starved = 0;
+		dir = WRITE;
+	} else
+		return NULL;
+/* a new batch: start with the oldest request if it has expired */
+	req = dev->fifo[dir];
+	if ((long) (jiffies - req->expires) < 0 && next_sorted(dev,dir))
+		req = next_sorted(dev,dir);
+	dev->batch = 0;
+dispatch:
+	unlink_request(dev,req);
+	dev->dir = dir;
+	dev->batch++;
+	dev->last_dev = req->dev;
+	dev->last_sector = req->sector + req->nr_sectors;
+	return req;
+}
+
+struct blk_sched deadline_sched = {
+	"deadline",
+	deadline_add,
+	deadline_next
+};
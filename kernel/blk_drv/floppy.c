@@ -101,8 +101,16 @@ static struct floppy_struct {
  * and ND is set means no DMA. Hardcoded to 6 (HLD=6ms, use DMA).
  */
 
+/*
+ * A merged request is transferred up to the end of the cylinder in one
+ * command (FD_READ/FD_WRITE have the multi-track bit set). The buffers
+ * of such a request aren't contiguous, so it goes through the bounce
+ * buffer in head.s, which is big enough for a cylinder of a 1.44MB disk.
+ */
+#define MAX_TRANSFER	(2*18)
+
 extern void floppy_interrupt(void);
-extern char tmp_floppy_area[1024];
+extern char tmp_floppy_area[MAX_TRANSFER*512];
 
 /*
  * These are global variables, as that's the easiest way to give
@@ -119,6 +127,26 @@ static unsigned char track = 0;
 static unsigned char seek_track = 0;
 static unsigned char current_track = 255;
 static unsigned char command = 0;
+static unsigned char nr_sectors = 0;
+
+/*
+ * The track buffer. A read always fetches the whole cylinder into
+ * tmp_floppy_area, and later reads of the same cylinder are copied out
+ * of it without touching the drive. 'buffer_dev' is -1 if the buffer
+ * holds nothing useful: writes (which use the area as bounce buffer),
+ * errors, resets and disk changes all throw it away.
+ */
+static int buffer_dev = -1;
+static unsigned char buffer_track = 0;
+static unsigned char read_track = 0;
+
+/*
+ * A bad sector anywhere on the cylinder fails the whole track read. That
+ * isn't counted against the request: it is retried reading just its own
+ * sectors, and only errors then count.
+ */
+static struct request * no_track = NULL;
+
 unsigned char selected = 0;
 struct task_struct * wait_on_floppy_select = NULL;
 
@@ -146,6 +174,8 @@ repeat:
 		goto repeat;
 	if (inb(FD_DIR) & 0x80) {
 		floppy_off(nr);
+		if (DRIVE(buffer_dev) == nr)
+			buffer_dev = -1;
 		return 1;
 	}
 	floppy_off(nr);
@@ -157,15 +187,76 @@ __asm__("cld ; rep ; movsl" \
 	::"c" (BLOCK_SIZE/4),"S" ((long)(from)),"D" ((long)(to)) \
 	)
 
+#define copy_sectors(from,to,nr) \
+__asm__("cld ; rep ; movsl" \
+	::"c" ((nr)<<7),"S" ((long)(from)),"D" ((long)(to)) \
+	)
+
+/*
+ * serve_from_track() copies the part of the current request that lies
+ * in the buffered cylinder out of the track buffer.
+ */
+static void serve_from_track(void)
+{
+	unsigned int cyl = floppy->sect * floppy->head;
+	unsigned int s = CURRENT->sector % cyl;
+	char * area = tmp_floppy_area + (s<<9);
+	int nr, left = cyl - s;
+
+	while (left > 0) {
+		nr = CURRENT->current_nr_sectors;
+		if (nr > left)
+			nr = left;
+		copy_sectors(area,CURRENT->buffer,nr);
+		area += nr<<9;
+		left -= nr;
+		CURRENT->sector += nr;
+		CURRENT->nr_sectors -= nr;
+		if (!CURRENT->nr_sectors) {
+			end_request(1);
+			return;
+		}
+		if (!(CURRENT->current_nr_sectors -= nr))
+			end_request(1);
+		else
+			CURRENT->buffer += nr<<9;
+	}
+}
+
+/*
+ * copy the 'nr_sectors' of the current transfer between the buffers of
+ * the request and the bounce buffer.
+ */
+static void copy_bounce(int to_bounce)
+{
+	struct buffer_head * bh = CURRENT->bh;
+	char * buf = CURRENT->buffer;
+	char * area = tmp_floppy_area;
+	int nr;
+
+	for (nr = nr_sectors ; nr > 0 ; nr -= 2, area += BLOCK_SIZE) {
+		if (to_bounce)
+			copy_buffer(buf,area);
+		else
+			copy_buffer(area,buf);
+		if (bh && (bh = bh->b_reqnext))
+			buf = bh->b_data;
+		else
+			buf += BLOCK_SIZE;
+	}
+}
+
 static void setup_DMA(void)
 {
 	long addr = (long) CURRENT->buffer;
+	long count = (nr_sectors<<9) - 1;
 
 	cli();
-	if (addr >= 0x100000) {
+	if (read_track || addr >= 0x100000 ||
+	    nr_sectors > CURRENT->current_nr_sectors) {
 		addr = (long) tmp_floppy_area;
 		if (command == FD_WRITE)
-			copy_buffer(CURRENT->buffer,tmp_floppy_area);
+			copy_bounce(1);
 	}
 /* mask DMA 2 */
 	immoutb_p(4|2,10);
@@ -182,10 +273,11 @@ static void setup_DMA(void)
 	addr >>= 8;
 /* bits 16-19 of addr */
 	immoutb_p(addr,0x81);
-/* low 8 bits of count-1 (1024-1=0x3ff) */
-	immoutb_p(0xff,5);
+/* low 8 bits of count-1 */
+	immoutb_p(count,5);
+	count >>= 8;
 /* high 8 bits of count-1 */
-	immoutb_p(3,5);
+	immoutb_p(count,5);
 /* activate DMA 2 */
 	immoutb_p(0|2,10);
 	sti();
@@ -232,8 +324,15 @@ static int result(void)
 
 static void bad_flp_intr(void)
 {
+	buffer_dev = -1;
+	if (read_track && no_track != CURRENT) {
+		no_track = CURRENT;
+		recalibrate = 1;
+		return;
+	}
 	CURRENT->errors++;
 	if (CURRENT->errors > MAX_ERRORS) {
+		no_track = NULL;
 		floppy_deselect(current_drive);
 		end_request(0);
 	}
@@ -249,6 +348,8 @@ static void bad_flp_intr(void)
  */
 static void rw_interrupt(void)
 {
+	int nr;
+
 	if (result() != 7 || (ST0 & 0xf8) || (ST1 & 0xbf) || (ST2 & 0x73)) {
 		if (ST1 & 0x02) {
 			printk("Drive %d is write protected\n\r",current_drive);
@@ -259,10 +360,29 @@ static void rw_interrupt(void)
 		do_fd_request();
 		return;
 	}
-	if (command == FD_READ && (unsigned long)(CURRENT->buffer) >= 0x100000)
-		copy_buffer(tmp_floppy_area,CURRENT->buffer);
+	if (read_track) {
+		buffer_dev = CURRENT->dev;
+		buffer_track = track;
+		floppy_deselect(current_drive);
+		serve_from_track();
+		do_fd_request();
+		return;
+	}
+	if (command == FD_READ && ((unsigned long)(CURRENT->buffer) >= 0x100000
+	    || nr_sectors > CURRENT->current_nr_sectors))
+		copy_bounce(0);
 	floppy_deselect(current_drive);
-	end_request(1);
+	no_track = NULL;
+	while (nr_sectors) {
+		nr = CURRENT->current_nr_sectors;
+		if (nr > nr_sectors)
+			nr = nr_sectors;
+		nr_sectors -= nr;
+		CURRENT->sector += nr;
+		CURRENT->nr_sectors -= nr;
+		if (!(CURRENT->current_nr_sectors -= nr) || !CURRENT->nr_sectors)
+			end_request(1);
+	}
 	do_fd_request();
 }
 
@@ -388,6 +508,7 @@ static void reset_floppy(void)
 	int i;
 
 	reset = 0;
+	buffer_dev = -1;
 	cur_spec1 = -1;
 	cur_rate = -1;
 	recalibrate = 1;
@@ -419,6 +540,7 @@ void do_fd_request(void)
 	unsigned int block;
 
 	seek = 0;
+	read_track = 0;
 	if (reset) {
 		reset_floppy();
 		return;
@@ -441,16 +563,34 @@ void do_fd_request(void)
 	block /= floppy->sect;
 	head = block % floppy->head;
 	track = block / floppy->head;
+	if (CURRENT->cmd == READ && buffer_dev == CURRENT->dev &&
+	    buffer_track == track) {
+		serve_from_track();
+		goto repeat;
+	}
+/* the rest of the request, but not beyond the end of this cylinder */
+	nr_sectors = floppy->sect * (floppy->head - head) - sector;
+	if (nr_sectors > CURRENT->nr_sectors)
+		nr_sectors = CURRENT->nr_sectors;
+	if (CURRENT->sector + nr_sectors > floppy->size)
+		nr_sectors = CURRENT->current_nr_sectors;
 	seek_track = track << floppy->stretch;
 	if (seek_track != current_track)
 		seek = 1;
-	sector++;
-	if (CURRENT->cmd == READ)
+	if (CURRENT->cmd == READ) {
 		command = FD_READ;
-	else if (CURRENT->cmd == WRITE)
+		buffer_dev = -1;
+		if (CURRENT != no_track) {
+			read_track = 1;
+			head = sector = 0;
+			nr_sectors = floppy->sect * floppy->head;
+		}
+	} else if (CURRENT->cmd == WRITE) {
 		command = FD_WRITE;
-	else
+		buffer_dev = -1;
+	} else
 		panic("do_fd_request: unknown command");
+	sector++;
 	add_timer(ticks_to_floppy_on(current_drive),&floppy_on_interrupt);
 }
 
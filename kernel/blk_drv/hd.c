@@ -21,6 +21,7 @@
 #include <asm/system.h>
 #include <asm/io.h>
 #include <asm/segment.h>
+#include <sys/iostat.h>
 
 #define MAJOR_NR 3
 #include "blk.h"
@@ -33,12 +34,43 @@ inb_p(0x71); \
 /* Max read/write errors/sector */
 #define MAX_ERRORS	7
 #define MAX_HD		2
+/* Max sectors per interrupt we ask for in multiple mode */
+#define MAX_MULT	16
 
 static void recal_intr(void);
 
 static int recalibrate = 1;
 static int reset = 1;
 
+/*
+ * Multiple-sector mode. mult_count[] is the nr of sectors per interrupt
+ * the drive can do (from IDENTIFY), 0 if it can't. A reset turns the
+ * mode off again, so mult_on[] tells if it has been set up since then.
+ * cur_mult is the block size of the command that is running.
+ */
+static int mult_count[MAX_HD] = {0,0};
+static int mult_on[MAX_HD] = {0,0};
+static int cur_mult = 1;
+
+/*
+ * Bus-master DMA. 'bmide' is the I/O base of the bus-master registers
+ * of the primary channel, 0 if there is no such controller. The PRD
+ * table has one entry per buffer of a request: it must not cross a
+ * 64kB border, which the alignment takes care of.
+ */
+#define PCI_CONF_ADDR	0xCF8
+#define PCI_CONF_DATA	0xCFC
+
+static unsigned short bmide = 0;
+static int dma_ok[MAX_HD] = {0,0};
+
+static struct prd {
+	unsigned long addr;
+	unsigned long count;		/* bit 31 set - last entry */
+} prd_table[MAX_SECTORS/2] __attribute__ ((aligned (MAX_SECTORS*4)));
+
+extern struct iostat io_stat;
+
 /*
  *  This struct defines the HD's and their types.
  */
@@ -58,15 +90,104 @@ static struct hd_struct {
 	long nr_sects;
 } hd[5*MAX_HD]={{0,0},};
 
+/*
+ * port_read() stores into memory gcc doesn't see, and both change the
+ * registers they are given: say so, or the compiler may keep stale
+ * copies of either around.
+ */
 #define port_read(port,buf,nr) \
-__asm__("cld;rep;insw"::"d" (port),"D" (buf),"c" (nr))
+({ int __d0, __d1; \
+__asm__ __volatile__("cld;rep;insw" \
+	:"=&D" (__d0),"=&c" (__d1) \
+	:"d" (port),"0" (buf),"1" (nr) \
+	:"memory"); })
 
 #define port_write(port,buf,nr) \
-__asm__("cld;rep;outsw"::"d" (port),"S" (buf),"c" (nr))
+({ int __d0, __d1; \
+__asm__ __volatile__("cld;rep;outsw" \
+	:"=&S" (__d0),"=&c" (__d1) \
+	:"d" (port),"0" (buf),"1" (nr) \
+	:"memory"); })
 
 extern void hd_interrupt(void);
 extern void rd_load(void);
 
+static int controller_ready(void);
+
+#ifndef HD_NO_DMA
+static unsigned long pci_read(int dev,int fn,int reg)
+{
+	outl(0x80000000 | (dev<<11) | (fn<<8) | (reg & 0xfc),PCI_CONF_ADDR);
+	return inl(PCI_CONF_DATA);
+}
+
+static void pci_write(int dev,int fn,int reg,unsigned long value)
+{
+	outl(0x80000000 | (dev<<11) | (fn<<8) | (reg & 0xfc),PCI_CONF_ADDR);
+	outl(value,PCI_CONF_DATA);
+}
+
+/*
+ * Look on PCI bus 0 for an IDE controller that can do bus-master DMA
+ * (prog-if bit 7), with the primary channel at the legacy ports. Its
+ * BAR4 has the bus-master registers. We also turn on bus-mastering in
+ * the command register, in case the BIOS didn't.
+ */
+static void find_bmide(void)
+{
+	int dev,fn;
+	unsigned long class,bar;
+
+	for (dev = 0 ; dev < 32 ; dev++)
+		for (fn = 0 ; fn < 8 ; fn++) {
+			if ((pci_read(dev,fn,0) & 0xffff) == 0xffff)
+				continue;
+			class = pci_read(dev,fn,8) >> 8;
+			if ((class >> 8) != 0x0101 || !(class & 0x80)
+			    || (class & 0x01))
+				continue;
+			bar = pci_read(dev,fn,0x20);
+			if (!(bar & 1) || !(bar & 0xfff0))
+				continue;
+			pci_write(dev,fn,4,pci_read(dev,fn,4) | 0x05);
+			bmide = bar & 0xfff0;
+			printk("IDE bus-master DMA at port 0x%x\n\r",bmide);
+			return;
+		}
+}
+#endif
+
+/*
+ * Ask the drive with IDENTIFY if it can do READ/WRITE MULTIPLE. This
+ * is done once from sys_setup(), with the drive interrupt disabled
+ * (nIEN), as we just poll for the data.
+ */
+static void identify_hd(int drive)
+{
+	unsigned short id[256];
+	int i,r = 0;
+
+	mult_count[drive] = 0;
+	if (!controller_ready())
+		return;
+	outb_p(hd_info[drive].ctl | 2,HD_CMD);
+	outb_p(0xA0|(drive<<4),HD_CURRENT);
+	outb(WIN_IDENTIFY,HD_COMMAND);
+	for (i = 0 ; i < 100000 ; i++)
+		if (!((r = inb_p(HD_STATUS)) & BUSY_STAT))
+			break;
+	if ((r & (BUSY_STAT | ERR_STAT | DRQ_STAT)) == DRQ_STAT) {
+		port_read(HD_DATA,id,256);
+		r = id[47] & 0xff;
+		for (i = MAX_MULT ; i > 1 && i > r ; i >>= 1)
+			/* nothing */ ;
+		if (i > 1)
+			mult_count[drive] = i;
+		dma_ok[drive] = bmide && (id[49] & 0x100);
+	}
+	outb_p(hd_info[drive].ctl,HD_CMD);
+}
+
 /* This may be used only once, enforced by 'static int callable' */
 int sys_setup(void * BIOS)
 {
@@ -133,6 +254,18 @@ int sys_setup(void * BIOS)
 		hd[i*5].start_sect = 0;
 		hd[i*5].nr_sects = 0;
 	}
+#ifndef HD_NO_DMA
+	if (NR_HD)
+		find_bmide();
+#endif
+	for (drive=0 ; drive<NR_HD ; drive++) {
+		identify_hd(drive);
+		if (dma_ok[drive])
+			printk("hd%d: using DMA\n\r",drive);
+		else if (mult_count[drive])
+			printk("hd%d: %d sectors per interrupt\n\r",
+				drive,mult_count[drive]);
+	}
 	for (drive=0 ; drive<NR_HD ; drive++) {
 		if (!(bh = bread(0x300 + drive*5,0))) {
 			printk("Unable to read partition table of drive %d\n\r",
@@ -229,6 +362,7 @@ static void reset_controller(void)
 
 static void reset_hd(int nr)
 {
+	mult_on[0] = mult_on[1] = 0;
 	reset_controller();
 	hd_out(nr,hd_info[nr].sect,hd_info[nr].sect,hd_info[nr].head-1,
 		hd_info[nr].cyl,WIN_SPECIFY,&recal_intr);
@@ -247,40 +381,87 @@ static void bad_rw_intr(void)
 		reset = 1;
 }
 
+/*
+ * next_sector() books one sector of the current request as done, and
+ * finishes the buffer if that was its last one. It returns the nr of
+ * sectors that are still left.
+ */
+static int next_sector(void)
+{
+	int i;
+
+	CURRENT->errors = 0;
+	CURRENT->buffer += 512;
+	CURRENT->sector++;
+	i = --CURRENT->nr_sectors;
+	if (!--CURRENT->current_nr_sectors || !i)
+		end_request(1);
+	return i;
+}
+
+/*
+ * write_block() hands the drive the next 'nr' sectors, which may go on
+ * into the following buffers of the request. Nothing is booked as done
+ * here: write_intr() does that when the drive has taken them.
+ */
+static void write_block(int nr)
+{
+	struct buffer_head * bh = CURRENT->bh;
+	char * buf = CURRENT->buffer;
+	int left = CURRENT->current_nr_sectors;
+
+	while (nr--) {
+		if (!left && bh && (bh = bh->b_reqnext)) {
+			buf = bh->b_data;
+			left = BLOCK_SIZE>>9;
+		}
+		port_write(HD_DATA,buf,256);
+		buf += 512;
+		left--;
+	}
+}
+
 static void read_intr(void)
 {
+	int i,nr = cur_mult;
+
 	if (win_result()) {
 		bad_rw_intr();
 		do_hd_request();
 		return;
 	}
-	port_read(HD_DATA,CURRENT->buffer,256);
-	CURRENT->errors = 0;
-	CURRENT->buffer += 512;
-	CURRENT->sector++;
-	if (--CURRENT->nr_sectors) {
+	io_stat.hd_intr++;
+	do {
+		port_read(HD_DATA,CURRENT->buffer,256);
+		io_stat.hd_sectors++;
+		i = next_sector();
+	} while (i && --nr);
+	if (i) {
 		do_hd = &read_intr;
 		return;
 	}
-	end_request(1);
 	do_hd_request();
 }
 
 static void write_intr(void)
 {
+	int i,nr = cur_mult;
+
 	if (win_result()) {
 		bad_rw_intr();
 		do_hd_request();
 		return;
 	}
-	if (--CURRENT->nr_sectors) {
-		CURRENT->sector++;
-		CURRENT->buffer += 512;
+	io_stat.hd_intr++;
+	do {
+		io_stat.hd_sectors++;
+		i = next_sector();
+	} while (i && --nr);
+	if (i) {
 		do_hd = &write_intr;
-		port_write(HD_DATA,CURRENT->buffer,256);
+		write_block((i < cur_mult)?i:cur_mult);
 		return;
 	}
-	end_request(1);
 	do_hd_request();
 }
 
@@ -291,6 +472,72 @@ static void recal_intr(void)
 	do_hd_request();
 }
 
+/*
+ * setup_dma() fills the PRD table with the rest of the current request
+ * and loads it into the controller. The transfer is started by
+ * do_hd_request() after the command has gone out.
+ */
+static void setup_dma(void)
+{
+	struct buffer_head * bh = CURRENT->bh;
+	struct prd * p = prd_table;
+	long nr = CURRENT->nr_sectors;
+
+	p->addr = (unsigned long) CURRENT->buffer;
+	p->count = CURRENT->current_nr_sectors;
+	while ((nr -= p->count) > 0 && bh && (bh = bh->b_reqnext)) {
+		p->count <<= 9;
+		p++;
+		p->addr = (unsigned long) bh->b_data;
+		p->count = (nr < (BLOCK_SIZE>>9))?nr:(BLOCK_SIZE>>9);
+	}
+	p->count = (p->count << 9) | 0x80000000;
+	outl((unsigned long) prd_table,bmide+BM_PRD);
+	outb((CURRENT->cmd == READ)?BM_READ:0,bmide+BM_COMMAND);
+	outb((inb(bmide+BM_STATUS) & BM_CAPABLE) | BM_ERR | BM_INTR,
+		bmide+BM_STATUS);
+}
+
+/*
+ * The whole rest of the request is done with one DMA transfer. If that
+ * fails, we give up on DMA for this drive and let PIO retry it.
+ */
+static void dma_intr(void)
+{
+	int i,status;
+
+	status = inb(bmide+BM_STATUS);
+	outb(0,bmide+BM_COMMAND);
+/* ERR and INTR are cleared by writing 1s: keep the capable bits as they are */
+	outb((status & BM_CAPABLE) | BM_ERR | BM_INTR,bmide+BM_STATUS);
+	if (win_result() || (status & BM_ERR)) {
+		io_stat.hd_dma_errors++;
+		printk("hd%d: DMA error, using PIO\n\r",CURRENT_DEV);
+		dma_ok[CURRENT_DEV] = 0;
+		bad_rw_intr();
+		do_hd_request();
+		return;
+	}
+	io_stat.hd_dma++;
+	io_stat.hd_intr++;
+	do {
+		io_stat.hd_sectors++;
+		i = next_sector();
+	} while (i);
+	do_hd_request();
+}
+
+/*
+ * If the drive refuses SET MULTIPLE, we just stay with one sector
+ * per interrupt for it.
+ */
+static void setmult_intr(void)
+{
+	if (win_result())
+		mult_count[CURRENT_DEV] = 0;
+	do_hd_request();
+}
+
 void do_hd_request(void)
 {
 	int i,r = 0;
@@ -301,7 +548,7 @@ void do_hd_request(void)
 	INIT_REQUEST;
 	dev = MINOR(CURRENT->dev);
 	block = CURRENT->sector;
-	if (dev >= 5*NR_HD || block+2 > hd[dev].nr_sects) {
+	if (dev >= 5*NR_HD || block+CURRENT->nr_sectors > hd[dev].nr_sects) {
 		end_request(0);
 		goto repeat;
 	}
@@ -325,17 +572,32 @@ void do_hd_request(void)
 			WIN_RESTORE,&recal_intr);
 		return;
 	}	
+	if (mult_count[dev] && !mult_on[dev]) {
+		mult_on[dev] = 1;
+		hd_out(dev,mult_count[dev],0,0,0,WIN_SETMULT,&setmult_intr);
+		return;
+	}
+	if (dma_ok[dev] && (CURRENT->cmd == READ || CURRENT->cmd == WRITE)) {
+		setup_dma();
+		hd_out(dev,nsect,sec,head,cyl,(CURRENT->cmd == READ)?
+			WIN_READDMA:WIN_WRITEDMA,&dma_intr);
+		outb(inb(bmide+BM_COMMAND) | BM_START,bmide+BM_COMMAND);
+		return;
+	}
+	cur_mult = mult_count[dev] ? mult_count[dev] : 1;
 	if (CURRENT->cmd == WRITE) {
-		hd_out(dev,nsect,sec,head,cyl,WIN_WRITE,&write_intr);
+		hd_out(dev,nsect,sec,head,cyl,
+			(cur_mult > 1)?WIN_MULTWRITE:WIN_WRITE,&write_intr);
 		for(i=0 ; i<3000 && !(r=inb_p(HD_STATUS)&DRQ_STAT) ; i++)
 			/* nothing */ ;
 		if (!r) {
 			bad_rw_intr();
 			goto repeat;
 		}
-		port_write(HD_DATA,CURRENT->buffer,256);
+		write_block((nsect < cur_mult)?nsect:cur_mult);
 	} else if (CURRENT->cmd == READ) {
-		hd_out(dev,nsect,sec,head,cyl,WIN_READ,&read_intr);
+		hd_out(dev,nsect,sec,head,cyl,
+			(cur_mult > 1)?WIN_MULTREAD:WIN_READ,&read_intr);
 	} else
 		panic("unknown hd-command");
 }
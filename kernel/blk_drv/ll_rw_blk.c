@@ -8,6 +8,7 @@
  * This handles all read/write requests to block devices
  */
 #include <errno.h>
+#include <linux/config.h>
 #include <linux/sched.h>
 #include <linux/kernel.h>
 #include <asm/system.h>
@@ -39,6 +40,12 @@ struct blk_dev_struct blk_dev[NR_BLK_DEV] = {
 	{ NULL, NULL }		/* dev lp */
 };
 
+/*
+ * the majors that use the deadline scheduler: BLK_DEADLINE in config.h,
+ * unless main() found another mask in the boot sector
+ */
+int blk_deadline = BLK_DEADLINE;
+
 static inline void lock_buffer(struct buffer_head * bh)
 {
 	cli();
@@ -57,61 +64,117 @@ static inline void unlock_buffer(struct buffer_head * bh)
 }
 
 /*
- * add-request adds a request to the linked list.
- * It disables interrupts so that it can muck with the
- * request-lists in peace.
+ * The elevator keeps the pending requests in one list, in the order
+ * they will be done: one pass up the disk, starting from the request
+ * that is being worked on. Reads go before writes.
  */
-static void add_request(struct blk_dev_struct * dev, struct request * req)
+static void elevator_add(struct blk_dev_struct * dev, struct request * req)
 {
-	struct request * tmp;
+	struct request * prev = dev->current_request;
+	struct request ** p = &dev->queue[0];
+
+	for ( ; *p ; prev = *p, p = &(*p)->next)
+		if ((!prev || IN_ORDER(prev,req) ||
+		    !IN_ORDER(prev,*p)) &&
+		    IN_ORDER(req,*p))
+			break;
+	req->next = *p;
+	*p = req;
+}
+
+static struct request * elevator_next(struct blk_dev_struct * dev)
+{
+	struct request * req;
+
+	if ((req = dev->queue[0])) {
+		dev->queue[0] = req->next;
+		req->next = NULL;
+	}
+	return req;
+}
 
+struct blk_sched elevator_sched = {
+	"elevator",
+	elevator_add,
+	elevator_next
+};
+
+/*
+ * add-request hands a request to the scheduler of the device, and
+ * starts the device if it was idle. It disables interrupts so that
+ * it can muck with the request-lists in peace.
+ */
+static void add_request(struct blk_dev_struct * dev, struct request * req)
+{
 	req->next = NULL;
 	cli();
 	if (req->bh)
-		req->bh->b_dirt = 0;
-	if (!(tmp = dev->current_request)) {
-		dev->current_request = req;
+		clear_buffer_dirty(req->bh);
+	(dev->sched->add)(dev,req);
+	if (!dev->current_request) {
+		dev->current_request = (dev->sched->next)(dev);
 		sti();
 		(dev->request_fn)();
 		return;
 	}
-	for ( ; tmp->next ; tmp=tmp->next)
-		if ((IN_ORDER(tmp,req) || 
-		    !IN_ORDER(tmp,tmp->next)) &&
-		    IN_ORDER(req,tmp->next))
-			break;
-	req->next=tmp->next;
-	tmp->next=req;
 	sti();
 }
 
-static void make_request(int major,int rw, struct buffer_head * bh)
+/*
+ * merge_request() tries to put the buffer into a request that is
+ * already queued for the same device: if the buffer is just behind or
+ * just in front of it on disk, it gets chained onto the request, and
+ * the driver can do both with one command. The first request in the
+ * queue is left alone, as the driver may already be working on it.
+ */
+static int merge_request(int major, int rw, struct buffer_head * bh)
 {
 	struct request * req;
-	int rw_ahead;
+	unsigned long sector = bh->b_blocknr<<1;
 
-/* WRITEA/READA is special case - it is not really needed, so if the */
-/* buffer is locked, we just forget about it, else it's a normal read */
-	if ((rw_ahead = (rw == READA || rw == WRITEA))) {
-		if (bh->b_lock)
-			return;
-		if (rw == READA)
-			rw = READ;
-		else
-			rw = WRITE;
-	}
-	if (rw!=READ && rw!=WRITE)
-		panic("Bad block dev command, must be R/W/RA/WA");
-	lock_buffer(bh);
-	if ((rw == WRITE && !bh->b_dirt) || (rw == READ && bh->b_uptodate)) {
-		unlock_buffer(bh);
-		return;
+	cli();
+	for (req = request ; req < request+NR_REQUEST ; req++) {
+		if (req->dev != bh->b_dev || req->cmd != rw || !req->bh)
+			continue;
+		if (req == blk_dev[major].current_request)
+			continue;
+		if (req->nr_sectors + 2 > MAX_SECTORS)
+			continue;
+		if (req->sector + req->nr_sectors == sector) {
+			req->bhtail->b_reqnext = bh;
+			req->bhtail = bh;
+		} else if (req->sector == sector + 2) {
+			bh->b_reqnext = req->bh;
+			req->bh = bh;
+			req->buffer = bh->b_data;
+			req->current_nr_sectors = 2;
+			req->sector = sector;
+		} else
+			continue;
+		req->nr_sectors += 2;
+		clear_buffer_dirty(bh);
+		sti();
+		return 1;
 	}
-repeat:
+	sti();
+	return 0;
+}
+
+/*
+ * queue_request() puts the buffers from bh to tail, chained through
+ * b_reqnext and locked, into a new request of nr_sectors. A read-ahead
+ * or write-ahead that finds no free request is dropped.
+ */
+static void queue_request(int major, int rw, struct buffer_head * bh,
+	struct buffer_head * tail, int nr_sectors, int rw_ahead)
+{
+	struct request * req;
+
 /* we don't allow the write-requests to fill up the queue completely:
  * we want some room for reads: they take precedence. The last third
  * of the requests are only for reads.
  */
+repeat:
 	if (rw == READ)
 		req = request+NR_REQUEST;
 	else
@@ -123,7 +186,11 @@ repeat:
 /* if none found, sleep on new requests: check for rw_ahead */
 	if (req < request) {
 		if (rw_ahead) {
-			unlock_buffer(bh);
+			for ( ; bh ; bh = tail) {
+				tail = bh->b_reqnext;
+				bh->b_reqnext = NULL;
+				unlock_buffer(bh);
+			}
 			return;
 		}
 		sleep_on(&wait_for_request);
@@ -134,14 +201,43 @@ repeat:
 	req->cmd = rw;
 	req->errors=0;
 	req->sector = bh->b_blocknr<<1;
-	req->nr_sectors = 2;
+	req->nr_sectors = nr_sectors;
+	req->current_nr_sectors = 2;
 	req->buffer = bh->b_data;
 	req->waiting = NULL;
 	req->bh = bh;
+	req->bhtail = tail;
 	req->next = NULL;
 	add_request(major+blk_dev,req);
 }
 
+static void make_request(int major,int rw, struct buffer_head * bh)
+{
+	int rw_ahead;
+
+/* WRITEA/READA is special case - it is not really needed, so if the */
+/* buffer is locked, we just forget about it, else it's a normal read */
+	if ((rw_ahead = (rw == READA || rw == WRITEA))) {
+		if (bh->b_lock)
+			return;
+		if (rw == READA)
+			rw = READ;
+		else
+			rw = WRITE;
+	}
+	if (rw!=READ && rw!=WRITE)
+		panic("Bad block dev command, must be R/W/RA/WA");
+	lock_buffer(bh);
+	if ((rw == WRITE && !bh->b_dirt) || (rw == READ && bh->b_uptodate)) {
+		unlock_buffer(bh);
+		return;
+	}
+	bh->b_reqnext = NULL;
+	if (merge_request(major,rw,bh))
+		return;
+	queue_request(major,rw,bh,bh,2,rw_ahead);
+}
+
 void ll_rw_block(int rw, struct buffer_head * bh)
 {
 	unsigned int major;
@@ -154,6 +250,92 @@ void ll_rw_block(int rw, struct buffer_head * bh)
 	make_request(major,rw,bh);
 }
 
+/*
+ * ll_rw_blocks() does nr buffers at once (NULL ones are skipped): the
+ * ones that follow each other on disk go into one request, which the
+ * driver can do with one command, instead of relying on merge_request()
+ * to catch them. A buffer somebody else has locked ends the run before
+ * we wait for it, so that we never sleep on a buffer while holding
+ * others locked that aren't queued yet.
+ */
+void ll_rw_blocks(int rw, int nr, struct buffer_head * bh[])
+{
+	struct buffer_head * first = NULL, * last = NULL, * tmp;
+	int i, n = 0;
+
+	if (rw!=READ && rw!=WRITE)
+		panic("Bad block dev command, must be R/W");
+	for (i=0 ; i<nr ; i++) {
+		if (!(tmp = bh[i]))
+			continue;
+		if (MAJOR(tmp->b_dev) >= NR_BLK_DEV ||
+		!(blk_dev[MAJOR(tmp->b_dev)].request_fn)) {
+			printk("Trying to read nonexistent block-device\n\r");
+			continue;
+		}
+		if (first && (tmp->b_lock || tmp->b_dev != first->b_dev ||
+		    tmp->b_blocknr != last->b_blocknr+1 || n+2 > MAX_SECTORS)) {
+			queue_request(MAJOR(first->b_dev),rw,first,last,n,0);
+			first = NULL;
+		}
+		lock_buffer(tmp);
+		if ((rw == WRITE && !tmp->b_dirt) || (rw == READ && tmp->b_uptodate)) {
+			unlock_buffer(tmp);
+			continue;
+		}
+		tmp->b_reqnext = NULL;
+		if (first) {
+			last->b_reqnext = tmp;
+			if (rw == WRITE)
+				clear_buffer_dirty(tmp);
+			n += 2;
+		} else {
+			first = tmp;
+			n = 2;
+		}
+		last = tmp;
+	}
+	if (first)
+		queue_request(MAJOR(first->b_dev),rw,first,last,n,0);
+}
+
+/*
+ * ll_rw_direct() is ll_rw_blocks() for the buffer heads of direct I/O
+ * (see direct_io() in fs/buffer.c). They are not in the cache, come in
+ * locked, and are always done: there's nothing to check.
+ */
+void ll_rw_direct(int rw, int nr, struct buffer_head * bh[])
+{
+	struct buffer_head * first = NULL, * last = NULL, * tmp;
+	int i, n = 0;
+
+	for (i=0 ; i<nr ; i++) {
+		if (!(tmp = bh[i]))
+			continue;
+		if (MAJOR(tmp->b_dev) >= NR_BLK_DEV ||
+		!(blk_dev[MAJOR(tmp->b_dev)].request_fn)) {
+			printk("Trying to read nonexistent block-device\n\r");
+			unlock_buffer(tmp);
+			continue;
+		}
+		if (first && (tmp->b_dev != first->b_dev ||
+		    tmp->b_blocknr != last->b_blocknr+1 || n+2 > MAX_SECTORS)) {
+			queue_request(MAJOR(first->b_dev),rw,first,last,n,0);
+			first = NULL;
+		}
+		if (first) {
+			last->b_reqnext = tmp;
+			n += 2;
+		} else {
+			first = tmp;
+			n = 2;
+		}
+		last = tmp;
+	}
+	if (first)
+		queue_request(MAJOR(first->b_dev),rw,first,last,n,0);
+}
+
 // 块设备初始化函数，由初始化程序main.c调用
 // 初始化请求数组，将所有请求项置为空闲（dev = -1）,有32项（NR_REQUEST = 32）
 void blk_dev_init(void)
@@ -164,4 +346,9 @@ void blk_dev_init(void)
 		request[i].dev = -1;
 		request[i].next = NULL;
 	}
+	for (i=0 ; i<NR_BLK_DEV ; i++)
+		if (blk_deadline & (1<<i))
+			blk_dev[i].sched = &deadline_sched;
+		else
+			blk_dev[i].sched = &elevator_sched;
 }
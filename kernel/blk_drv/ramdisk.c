@@ -27,7 +27,7 @@ void do_rd_request(void)
 
 	INIT_REQUEST;
 	addr = rd_start + (CURRENT->sector << 9);
-	len = CURRENT->nr_sectors << 9;
+	len = CURRENT->current_nr_sectors << 9;
 	if ((MINOR(CURRENT->dev) != 1) || (addr+len > rd_start+rd_length)) {
 		end_request(0);
 		goto repeat;
@@ -42,6 +42,8 @@ void do_rd_request(void)
 			      len);
 	} else
 		panic("unknown ramdisk-command");
+	CURRENT->sector += CURRENT->current_nr_sectors;
+	CURRENT->nr_sectors -= CURRENT->current_nr_sectors;
 	end_request(1);
 	goto repeat;
 }
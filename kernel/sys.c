@@ -12,6 +12,7 @@
 #include <asm/segment.h>
 #include <sys/times.h>
 #include <sys/utsname.h>
+#include <sys/iostat.h>
 
 // 返回日期和时间
 // 以下返回值是-ENOSYS的系统调用函数均表示在本版本内核中还未实现。
@@ -290,6 +291,24 @@ int sys_uname(struct utsname * name)
 	return 0;
 }
 
+/*
+ * The block-I/O counters. The drivers and the buffer-cache just
+ * increment these, iostat() hands out a copy.
+ */
+struct iostat io_stat = {0,};
+
+int sys_iostat(struct iostat * buf)
+{
+	int i;
+
+	if (!buf) return -EINVAL;
+	verify_area(buf,sizeof *buf);
+	for (i=0;i<sizeof *buf;i+=4)
+		put_fs_long(*(unsigned long *)(i+(char *) &io_stat),
+			(unsigned long *)(i+(char *) buf));
+	return 0;
+}
+
 // 设置当前进程创建文件属性屏蔽码为mask & 0777。并返回原屏蔽码。
 int sys_umask(int mask)
 {
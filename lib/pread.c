@@ -0,0 +1,29 @@
+/*
+ *  linux/lib/pread.c
+ */
+
+#define __LIBRARY__
+#include <unistd.h>
+#include <sys/uio.h>
+
+/*
+ * A system call gets 3 arguments at most, so the buffer and count go to
+ * the kernel in an iovec: the system call is pread(fildes,&iov,offset).
+ */
+int pread(int fildes, char * buf, int count, off_t offset)
+{
+	struct iovec iov;
+	long __res;
+
+	iov.iov_base = buf;
+	iov.iov_len = count;
+	__asm__ volatile ("int $0x80"
+		: "=a" (__res)
+		: "0" (__NR_pread),"b" ((long) fildes),"c" ((long) &iov),
+		  "d" ((long) offset)
+		: "memory");
+	if (__res >= 0)
+		return (int) __res;
+	errno = -__res;
+	return -1;
+}
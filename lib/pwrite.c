@@ -0,0 +1,29 @@
+/*
+ *  linux/lib/pwrite.c
+ */
+
+#define __LIBRARY__
+#include <unistd.h>
+#include <sys/uio.h>
+
+/*
+ * A system call gets 3 arguments at most, so the buffer and count go to
+ * the kernel in an iovec: the system call is pwrite(fildes,&iov,offset).
+ */
+int pwrite(int fildes, const char * buf, int count, off_t offset)
+{
+	struct iovec iov;
+	long __res;
+
+	iov.iov_base = (void *) buf;
+	iov.iov_len = count;
+	__asm__ volatile ("int $0x80"
+		: "=a" (__res)
+		: "0" (__NR_pwrite),"b" ((long) fildes),"c" ((long) &iov),
+		  "d" ((long) offset)
+		: "memory");
+	if (__res >= 0)
+		return (int) __res;
+	errno = -__res;
+	return -1;
+}
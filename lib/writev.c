@@ -0,0 +1,9 @@
+/*
+ *  linux/lib/writev.c
+ */
+
+#define __LIBRARY__
+#include <unistd.h>
+#include <sys/uio.h>
+
+_syscall3(int,writev,int,fildes,const struct iovec *,iov,int,iovcnt)
@@ -27,6 +27,7 @@
 #include <linux/sched.h>
 #include <linux/head.h>
 #include <linux/kernel.h>
+#include <asm/segment.h>
 
 // 函数名前的关键字volatile用于告诉编译器gcc该函数不会返回。这样可以让gcc产生更
 // 好一些的代码，更重要的是使用这个关键字可以避免产生某些(未初始化变量的)假警告信息。
@@ -78,6 +79,13 @@ __asm__("cld ; rep ; movsl"::"S" (from),"D" (to),"c" (1024))
 // 不能用做主内存页面的位置均都预先被设置成USED（100）.
 static unsigned char mem_map [ PAGING_PAGES ] = {0,};
 
+/*
+ * nr_free_pages counts the free pages of main memory. When it gets low,
+ * get_free_page() asks the buffer cache to give some pages back.
+ */
+int nr_free_pages = 0;
+extern void shrink_buffers(void);
+
 /*
  * Get physical address of first (actually last :-) free page, and mark it
  * used. If no free pages left, return 0.
@@ -96,6 +104,7 @@ unsigned long get_free_page(void)
 {
 register unsigned long __res asm("ax");
 
+shrink_buffers();
 __asm__("std ; repne ; scasb\n\t"   // 置方向位，al(0)与对应每个页面的(di)内容比较
 	"jne 1f\n\t"                    // 如果没有等于0的字节，则跳转结束(返回0).
 	"movb $1,1(%%edi)\n\t"          // 1 => [1+edi],将对应页面内存映像bit位置1.
@@ -111,6 +120,8 @@ __asm__("std ; repne ; scasb\n\t"   // 置方向位，al(0)与对应每个页面
 	:"0" (0),"i" (LOW_MEM),"c" (PAGING_PAGES),
 	"D" (mem_map+PAGING_PAGES-1)
 	);
+if (__res)
+	nr_free_pages--;
 return __res;           // 返回空闲物理页面地址(若无空闲页面则返回0).
 }
 
@@ -136,7 +147,11 @@ void free_page(unsigned long addr)
     // 物理页面本来就是空闲的，说明内核代码出问题。于是显示出错信息并停机。
 	addr -= LOW_MEM;
 	addr >>= 12;
-	if (mem_map[addr]--) return;
+	if (mem_map[addr]--) {
+		if (!mem_map[addr])
+			nr_free_pages++;
+		return;
+	}
 	mem_map[addr]=0;
 	panic("trying to free free page");
 }
@@ -456,6 +471,29 @@ void write_verify(unsigned long address)
 	return;
 }
 
+/*
+ * user_page() gives the physical address behind the user address 'addr',
+ * for direct I/O: the driver then moves the data itself. The page is
+ * faulted in first, and if the disk is to write into it, unshared, as
+ * the driver goes around the write protection. 0 if there's no page.
+ */
+unsigned long user_page(unsigned long addr, int write)
+{
+	unsigned long page;
+
+	(void) get_fs_byte((char *) addr);
+	addr += get_base(current->ldt[2]);
+	if (write)
+		write_verify(addr);
+	page = *(unsigned long *) ((addr>>20) & 0xffc);
+	if (!(page & 1))
+		return 0;
+	page = ((unsigned long *) (page & 0xfffff000))[(addr>>12) & 0x3ff];
+	if (!(page & 1))
+		return 0;
+	return (page & 0xfffff000) + (addr & 0xfff);
+}
+
 //// 取得一页空闲内存页并映射到指定线性地址处。
 // get_free_page()仅是申请取得了主内存区的一页物理内存。而本函数则不仅是获取到
 // 一页物理内存页面，还进一步调用put_page()，将物理页面映射到指定的线性地址处。
@@ -708,6 +746,7 @@ void mem_init(long start_mem, long end_mem)
 	i = MAP_NR(start_mem);      // 主内存区其实位置处页面号
 	end_mem -= start_mem;
 	end_mem >>= 12;             // 主内存区中的总页面数
+	nr_free_pages = end_mem;
 	while (end_mem-->0)
 		mem_map[i++]=0;         // 主内存区页面对应字节值清零
 }
@@ -51,7 +51,7 @@ void die(char * str)
 
 void usage(void)
 {
-	die("Usage: build bootsect setup system [rootdev] [> image]");
+	die("Usage: build bootsect setup system [rootdev [blksched]] [> image]");
 }
 
 int main(int argc, char ** argv)
@@ -59,11 +59,13 @@ int main(int argc, char ** argv)
 	int i,c,id;
 	char buf[1024];
 	char major_root, minor_root;
+	long blk_sched = 0xffff;
+	char * end;
 	struct stat sb;
 
-	if ((argc != 4) && (argc != 5))
+	if ((argc < 4) || (argc > 6))
 		usage();
-	if (argc == 5) {
+	if (argc >= 5) {
 		if (strcmp(argv[4], "FLOPPY")) {
 			if (stat(argv[4], &sb)) {
 				perror(argv[4]);
@@ -86,6 +88,12 @@ int main(int argc, char ** argv)
 			major_root);
 		die("Bad root device --- major #");
 	}
+	if (argc == 6) {
+		blk_sched = strtol(argv[5], &end, 0);
+		if (*end || blk_sched < 0 || blk_sched > 0xffff)
+			die("Bad deadline scheduler mask");
+		fprintf(stderr, "Deadline scheduler mask is 0x%lx\n", blk_sched);
+	}
 	for (i=0;i<sizeof buf; i++) buf[i]=0;
 	if ((id=open(argv[1],O_RDONLY,0))<0)
 		die("Unable to open 'boot'");
@@ -111,6 +119,10 @@ int main(int argc, char ** argv)
 		die("Boot block hasn't got boot flag (0xAA55)");
 	buf[508] = (char) minor_root;
 	buf[509] = (char) major_root;	
+	if (blk_sched != 0xffff) {
+		buf[506] = (char) blk_sched;
+		buf[507] = (char) (blk_sched >> 8);
+	}
 	i=write(1,buf,512);
 	if (i!=512)
 		die("Write call failed");
@@ -0,0 +1,81 @@
+/*
+ *  linux/tools/readbench.c
+ */
+
+/*
+ * This is not part of the kernel build: it is compiled and run on the
+ * running system, to time read() on a file that is in the buffer cache.
+ *
+ *	readbench file [bufsize [passes]]
+ *
+ * The file is read once to get it into the cache, and then 'passes'
+ * times more with reads of 'bufsize' bytes. As nothing has to come off
+ * the disk, what is measured is the system call and the copy to user
+ * space. Try an odd bufsize too, to see the unaligned case.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/times.h>
+
+#define HZ 100
+#define MAX_BUF 65536
+
+static char buf[MAX_BUF];
+
+static long read_file(int fd, char * p, int size)
+{
+	long total = 0;
+	int n;
+
+	if (lseek(fd,0,0) < 0) {
+		perror("lseek");
+		exit(1);
+	}
+	while ((n = read(fd,p,size)) > 0)
+		total += n;
+	if (n < 0) {
+		perror("read");
+		exit(1);
+	}
+	return total;
+}
+
+int main(int argc, char ** argv)
+{
+	struct tms t0, t1;
+	long start, ticks, bytes = 0;
+	int fd, i, size = 1024, passes = 20;
+
+	if (argc < 2 || argc > 4) {
+		fprintf(stderr,"usage: readbench file [bufsize [passes]]\n");
+		exit(1);
+	}
+	if (argc > 2)
+		size = atoi(argv[2]);
+	if (argc > 3)
+		passes = atoi(argv[3]);
+	if (size < 1 || size > MAX_BUF || passes < 1) {
+		fprintf(stderr,"readbench: bad bufsize or passes\n");
+		exit(1);
+	}
+	if ((fd = open(argv[1],O_RDONLY)) < 0) {
+		perror(argv[1]);
+		exit(1);
+	}
+	read_file(fd,buf,size);			/* get it into the cache */
+	start = times(&t0);
+	for (i = 0 ; i < passes ; i++)
+		bytes += read_file(fd,buf,size);
+	ticks = times(&t1) - start;
+	printf("%ld bytes in %ld.%02ld s (system %ld.%02ld s)",
+		bytes, ticks/HZ, ticks%HZ,
+		(t1.tms_stime-t0.tms_stime)/HZ, (t1.tms_stime-t0.tms_stime)%HZ);
+	if (ticks)
+		printf(", %ld kB/s",bytes/1024*HZ/ticks);
+	printf("\n");
+	return 0;
+}